@@ -1,62 +1,3721 @@
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TABLE_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics without /arch, GCC and Clang need the target attribute on the function
+#define TABLE_TARGET_AVX2
+#else
+#define TABLE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
 #include "osrm/match_parameters.hpp"
 #include "osrm/nearest_parameters.hpp"
 #include "osrm/route_parameters.hpp"
 #include "osrm/table_parameters.hpp"
 #include "osrm/trip_parameters.hpp"
 
-#include "osrm/coordinate.hpp"
-#include "osrm/engine_config.hpp"
-#include "osrm/json_container.hpp"
+#include "osrm/coordinate.hpp"
+#include "osrm/engine_config.hpp"
+#include "osrm/json_container.hpp"
+
+#include "osrm/osrm.hpp"
+#include "osrm/status.hpp"
+
+#include "engine/api/flatbuffers/fbresult_generated.h"
+
+#include <exception>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <iomanip>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <charconv>
+#include <string_view>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <queue>
+#include <random>
+#include <filesystem>
+
+enum class WorkMode {
+    drive,
+    workdrive,
+    result,
+    workdrivesymc,
+    resultsymc,
+    benchparse,
+    batch,
+    sparse,
+    solve,
+    evaltours,
+    bench,
+    benchalgo
+};
+
+WorkMode parse_work_mode(const std::string& mode) {
+    if (mode == "drive") {
+        return WorkMode::drive;
+    }
+    if (mode == "workdrive") {
+        return WorkMode::workdrive;
+    }
+    if (mode == "result") {
+        return WorkMode::result;
+    }
+    if (mode == "workdrivesymc") {
+        return WorkMode::workdrivesymc;
+    }
+    if (mode == "resultsymc") {
+        return WorkMode::resultsymc;
+    }
+    if (mode == "benchparse") {
+        return WorkMode::benchparse;
+    }
+    if (mode == "batch") {
+        return WorkMode::batch;
+    }
+    if (mode == "sparse") {
+        return WorkMode::sparse;
+    }
+    if (mode == "solve") {
+        return WorkMode::solve;
+    }
+    if (mode == "evaltours") {
+        return WorkMode::evaltours;
+    }
+    if (mode == "bench") {
+        return WorkMode::bench;
+    }
+    if (mode == "benchalgo") {
+        return WorkMode::benchalgo;
+    }
+    throw std::runtime_error("Unknown mode: " + mode + ". Supported modes: drive, workdrive, result, workdrivesymc, resultsymc, benchparse, batch, sparse, solve, evaltours, bench, benchalgo.");
+}
+
+// Switches of the form --name=value (or just --name) may appear anywhere after the program name.
+// They are removed from argv so that the positional arguments keep their documented order.
+using CommandLineOptions = std::unordered_map<std::string, std::string>;
+
+int extract_options(int argc, const char* argv[], CommandLineOptions& options) {
+    int positional_count = 0;
+    for (int i = 0; i < argc; i++) {
+        const std::string argument(argv[i]);
+        if (i > 0 && argument.size() > 2 && argument.compare(0, 2, "--") == 0) {
+            const size_t equals = argument.find('=');
+            if (equals == std::string::npos) {
+                options[argument.substr(2)] = "";
+            }
+            else {
+                options[argument.substr(2, equals - 2)] = argument.substr(equals + 1);
+            }
+            continue;
+        }
+        argv[positional_count++] = argv[i];
+    }
+    return positional_count;
+}
+
+// Every option some mode reads. Any other name is rejected, so that a misspelt option does not silently run with the default.
+const char* const known_options[] = {
+    "algorithm", "backend", "band-rows", "bench-max-full", "binary-matrix", "dataset-name", "dedup-tolerance", "geojson", "hints-cache",
+    "iterations", "jobs", "matrix", "missing-penalty", "neighbours", "no-dedup", "osrm-file", "outputs", "previous-input", "previous-output",
+    "repetitions", "setups", "shared-memory", "sparse-matrix", "starts", "stats", "symmetrise", "synthetic-asymmetry", "synthetic-speed", "threads", "tile-size",
+    "triangle"
+};
+
+// The given options that are not in known_options, sorted by name.
+std::vector<std::string> unknown_options(const CommandLineOptions& options) {
+    std::vector<std::string> unknown;
+    for (const auto& option : options) {
+        if (std::find(std::begin(known_options), std::end(known_options), option.first) == std::end(known_options)) {
+            unknown.push_back(option.first);
+        }
+    }
+    std::sort(unknown.begin(), unknown.end());
+    return unknown;
+}
+
+size_t option_size(const CommandLineOptions& options, const std::string& name, size_t default_value) {
+    const auto option = options.find(name);
+    if (option == options.end()) {
+        return default_value;
+    }
+    try {
+        return std::stoul(option->second);
+    }
+    catch (std::exception&) {
+        throw std::runtime_error("invalid value for --" + name + ": " + option->second);
+    }
+}
+
+unsigned default_thread_count() {
+    const unsigned hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads == 0 ? 1 : hardware_threads;
+}
+
+// Calls function(i) for every i in [0, count) on up to thread_count threads.
+// The first exception thrown by any call stops the remaining work and is rethrown to the caller.
+template <typename Function>
+void parallel_for(size_t count, unsigned thread_count, Function function) {
+    std::atomic<size_t> next_index{ 0 };
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next_index++; i < count; i = next_index++) {
+            try {
+                function(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error) {
+                    first_error = std::current_exception();
+                }
+                next_index = count;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count && t < count; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+}
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& filename) {
+#ifdef _WIN32
+        file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("error opening file " + filename);
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file_, &file_size)) {
+            close();
+            throw std::runtime_error("error reading size of file " + filename);
+        }
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        if (size_ == 0) {
+            return;
+        }
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_ != nullptr) {
+            data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+#else
+        const int descriptor = ::open(filename.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::runtime_error("error opening file " + filename);
+        }
+        struct stat file_status;
+        if (::fstat(descriptor, &file_status) != 0) {
+            ::close(descriptor);
+            throw std::runtime_error("error reading size of file " + filename);
+        }
+        size_ = static_cast<size_t>(file_status.st_size);
+        if (size_ == 0) {
+            ::close(descriptor);
+            return;
+        }
+        void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+        if (address != MAP_FAILED) {
+            data_ = static_cast<const char*>(address);
+        }
+#endif
+        if (data_ == nullptr) {
+            close();
+            throw std::runtime_error("error mapping file " + filename);
+        }
+    }
+
+    MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            close();
+            std::swap(data_, other.data_);
+            std::swap(size_, other.size_);
+#ifdef _WIN32
+            std::swap(file_, other.file_);
+            std::swap(mapping_, other.mapping_);
+#endif
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    void close() {
+#ifdef _WIN32
+        if (data_ != nullptr) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_ != nullptr) {
+            CloseHandle(mapping_);
+        }
+        if (file_ != INVALID_HANDLE_VALUE) {
+            CloseHandle(file_);
+        }
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+// Table durations in seconds, stored row-major in one contiguous buffer.
+// Rows are the query sources and columns the query destinations.
+struct DurationMatrix {
+    size_t rows = 0;
+    size_t columns = 0;
+    // square matrix of which only the cells with column <= row are stored, row by row like LOWER_DIAG_ROW
+    bool lower_triangle = false;
+    std::vector<float> values;
+
+    // OSRM computes durations in whole deciseconds. Rounding the float back to deciseconds
+    // restores exactly the double the JSON result carries, so the output does not depend on the result format.
+    static double seconds(float duration) {
+        return std::round(duration * 10.0) / 10.0;
+    }
+
+    double at(size_t row, size_t column) const {
+        return seconds(row_begin(row)[column]);
+    }
+
+    const float* row(size_t row) const {
+        return row_begin(row);
+    }
+
+    // Raw duration of a cell, the lower triangle layout answers column > row with the cell of the pair it holds.
+    float value(size_t row, size_t column) const {
+        if (lower_triangle && column > row) {
+            std::swap(row, column);
+        }
+        return row_begin(row)[column];
+    }
+
+    float* row_begin(size_t row) {
+        return values.data() + (lower_triangle ? row * (row + 1) / 2 : row * columns);
+    }
+
+    const float* row_begin(size_t row) const {
+        return values.data() + (lower_triangle ? row * (row + 1) / 2 : row * columns);
+    }
+};
+
+// Road geometry of the fastest route from one coordinate to another as (longitude, latitude) points.
+struct RoutedLeg {
+    double seconds = 0;
+    std::vector<std::pair<double, double> > points;
+};
+
+// The routing calls of all modes: a Table query and a two point Route. Implementations are safe to call concurrently.
+class RoutingBackend {
+public:
+    virtual ~RoutingBackend() = default;
+
+    // Durations of the table query, one row per source and one column per destination (all coordinates if empty).
+    // With snapped_hints the base64 hint of every params.coordinates entry the query snapped is stored there, empty if unknown.
+    virtual DurationMatrix table(const osrm::TableParameters& params, std::vector<std::string>* snapped_hints) const = 0;
+
+    virtual RoutedLeg route(const osrm::util::Coordinate& from, const osrm::util::Coordinate& to) const = 0;
+
+    // Identifies the routing data, snapping hints are only valid for the data they were returned by.
+    virtual std::string fingerprint() const = 0;
+};
+
+// Routing on a .osrm dataset with libosrm.
+class OsrmBackend : public RoutingBackend {
+public:
+    OsrmBackend(const osrm::EngineConfig& config, std::string fingerprint) : osrm_(config), fingerprint_(std::move(fingerprint)) {
+    }
+
+    // Runs one Table query and returns its durations, throws on OSRM errors.
+    // The flatbuffers result delivers the durations as one float vector, so no per-cell json::Value tree is built.
+    // Flatbuffers report unreachable cells as 0 where the JSON result has null, such cells are an error (see below).
+    DurationMatrix table(const osrm::TableParameters& params, std::vector<std::string>* snapped_hints) const override {
+        using namespace osrm;
+
+        engine::api::ResultT result = flatbuffers::FlatBufferBuilder();
+
+        const auto status = osrm_.Table(params, result);
+
+        auto& builder = result.get<flatbuffers::FlatBufferBuilder>();
+        const auto response = engine::api::fbresult::GetFBResult(builder.GetBufferPointer());
+
+        if (status == Status::Error || response->error())
+        {
+            std::string code = response->code()->code()->str();
+            std::string message = response->code()->message()->str();
+
+            throw std::runtime_error("OSRM error: " + code + ". " + message);
+        }
+
+        DurationMatrix matrix;
+        matrix.rows = params.sources.empty() ? params.coordinates.size() : params.sources.size();
+        matrix.columns = params.destinations.empty() ? params.coordinates.size() : params.destinations.size();
+
+        const auto durations = response->table() == nullptr ? nullptr : response->table()->durations();
+        if (durations == nullptr || durations->size() != matrix.rows * matrix.columns) {
+            throw std::runtime_error("OSRM error: table result does not contain " + std::to_string(matrix.rows) + "x" + std::to_string(matrix.columns) + " durations");
+        }
+        matrix.values.assign(durations->data(), durations->data() + durations->size());
+
+        // A 0 between two waypoints that snapped to different places is an unreachable pair, the JSON result has null there.
+        // Writing it as 0 minutes would make the leg free for the solver, so it fails the run like the null did before.
+        const auto source_waypoints = response->waypoints();
+        const auto destination_waypoints = response->table()->destinations();
+        const bool have_waypoints = source_waypoints != nullptr && destination_waypoints != nullptr
+            && source_waypoints->size() == matrix.rows && destination_waypoints->size() == matrix.columns;
+        for (size_t row = 0; row < matrix.rows; row++) {
+            for (size_t column = 0; column < matrix.columns; column++) {
+                if (matrix.values[row * matrix.columns + column] != 0) {
+                    continue;
+                }
+                const auto& from = params.coordinates[params.sources.empty() ? row : params.sources[row]];
+                const auto& to = params.coordinates[params.destinations.empty() ? column : params.destinations[column]];
+                bool same_place = from == to;
+                if (have_waypoints) {
+                    const auto from_location = source_waypoints->Get(static_cast<flatbuffers::uoffset_t>(row))->location();
+                    const auto to_location = destination_waypoints->Get(static_cast<flatbuffers::uoffset_t>(column))->location();
+                    same_place = from_location != nullptr && to_location != nullptr
+                        && from_location->longitude() == to_location->longitude() && from_location->latitude() == to_location->latitude();
+                }
+                if (!same_place) {
+                    std::ostringstream message;
+                    message << "OSRM error: NoRoute. No route from " << static_cast<double>(from.lat.__value) / 1000000.0 << "," << static_cast<double>(from.lon.__value) / 1000000.0
+                        << " to " << static_cast<double>(to.lat.__value) / 1000000.0 << "," << static_cast<double>(to.lon.__value) / 1000000.0 << " (unreachable table cell)";
+                    throw std::runtime_error(message.str());
+                }
+            }
+        }
+
+        if (snapped_hints != nullptr) {
+            // the source waypoints come in the order of params.sources, the destination waypoints in the order of params.destinations
+            snapped_hints->assign(params.coordinates.size(), std::string());
+            auto collect = [&](const flatbuffers::Vector<flatbuffers::Offset<engine::api::fbresult::Waypoint>>* waypoints, const std::vector<size_t>& indices) {
+                if (waypoints == nullptr) {
+                    return;
+                }
+                for (size_t i = 0; i < waypoints->size() && i < (indices.empty() ? params.coordinates.size() : indices.size()); i++) {
+                    const auto hint = waypoints->Get(static_cast<flatbuffers::uoffset_t>(i))->hint();
+                    if (hint != nullptr) {
+                        (*snapped_hints)[indices.empty() ? i : indices[i]] = hint->str();
+                    }
+                }
+            };
+            collect(response->waypoints(), params.sources);
+            collect(response->table()->destinations(), params.destinations);
+        }
+
+        return matrix;
+    }
+
+    RoutedLeg route(const osrm::util::Coordinate& from, const osrm::util::Coordinate& to) const override {
+        using namespace osrm;
+
+        RouteParameters params;
+        params.coordinates = { from, to };
+        params.geometries = RouteParameters::GeometriesType::GeoJSON;
+        params.overview = RouteParameters::OverviewType::Full;
+
+        engine::api::ResultT result = json::Object();
+        const auto status = osrm_.Route(params, result);
+
+        auto& response = result.get<json::Object>();
+        if (status == Status::Error)
+        {
+            const auto code = response.values["code"].get<json::String>().value;
+            const auto message = response.values["message"].get<json::String>().value;
+
+            throw std::runtime_error("OSRM error: " + code + ". " + message);
+        }
+
+        auto& route = response.values["routes"].get<json::Array>().values.at(0).get<json::Object>();
+        RoutedLeg leg;
+        leg.seconds = route.values["duration"].get<json::Number>().value;
+        auto& points = route.values["geometry"].get<json::Object>().values["coordinates"].get<json::Array>().values;
+        leg.points.reserve(points.size());
+        for (auto& point : points) {
+            auto& lonLat = point.get<json::Array>().values;
+            leg.points.emplace_back(lonLat.at(0).get<json::Number>().value, lonLat.at(1).get<json::Number>().value);
+        }
+        return leg;
+    }
+
+    std::string fingerprint() const override {
+        return fingerprint_;
+    }
+
+private:
+    // Routing machine with several services (such as Route, Table, Nearest, Trip, Match)
+    const osrm::OSRM osrm_;
+    const std::string fingerprint_;
+};
+
+// Deterministic routing without map data: great circle distance at a constant speed, rounded to deciseconds like OSRM.
+// Routes are straight lines. Used for benchmarks and for runs on machines without the .osrm dataset.
+// With asymmetry_percent > 0 legs heading east take that much longer, so A -> B and B -> A differ like on real roads.
+class SyntheticBackend : public RoutingBackend {
+public:
+    explicit SyntheticBackend(double kilometres_per_hour, double asymmetry_percent = 0.0)
+        : metres_per_second_(kilometres_per_hour / 3.6), eastward_factor_(1.0 + asymmetry_percent / 100.0) {
+        if (!(kilometres_per_hour > 0)) {
+            throw std::runtime_error("the synthetic backend needs a positive speed");
+        }
+        if (!(asymmetry_percent >= 0)) {
+            throw std::runtime_error("the synthetic backend needs a non-negative asymmetry");
+        }
+    }
+
+    DurationMatrix table(const osrm::TableParameters& params, std::vector<std::string>* snapped_hints) const override {
+        if (snapped_hints != nullptr) {
+            snapped_hints->assign(params.coordinates.size(), std::string());
+        }
+        DurationMatrix matrix;
+        matrix.rows = params.sources.empty() ? params.coordinates.size() : params.sources.size();
+        matrix.columns = params.destinations.empty() ? params.coordinates.size() : params.destinations.size();
+        matrix.values.resize(matrix.rows * matrix.columns);
+        for (size_t row = 0; row < matrix.rows; row++) {
+            const auto& from = params.coordinates[params.sources.empty() ? row : params.sources[row]];
+            for (size_t column = 0; column < matrix.columns; column++) {
+                const auto& to = params.coordinates[params.destinations.empty() ? column : params.destinations[column]];
+                matrix.values[row * matrix.columns + column] = static_cast<float>(seconds(from, to));
+            }
+        }
+        return matrix;
+    }
+
+    RoutedLeg route(const osrm::util::Coordinate& from, const osrm::util::Coordinate& to) const override {
+        RoutedLeg leg;
+        leg.seconds = seconds(from, to);
+        leg.points = { { degrees(from.lon.__value), degrees(from.lat.__value) }, { degrees(to.lon.__value), degrees(to.lat.__value) } };
+        return leg;
+    }
+
+    std::string fingerprint() const override {
+        return "synthetic:" + std::to_string(metres_per_second_) + (eastward_factor_ != 1.0 ? ":" + std::to_string(eastward_factor_) : std::string());
+    }
+
+private:
+    template <typename Fixed>
+    static double degrees(Fixed value) {
+        return static_cast<double>(value) / 1000000.0;
+    }
+
+    double seconds(const osrm::util::Coordinate& from, const osrm::util::Coordinate& to) const {
+        const double radians = 3.14159265358979323846 / 180.0;
+        const double from_latitude = degrees(from.lat.__value) * radians;
+        const double to_latitude = degrees(to.lat.__value) * radians;
+        const double half_latitude = (to_latitude - from_latitude) / 2.0;
+        const double half_longitude = (degrees(to.lon.__value) - degrees(from.lon.__value)) * radians / 2.0;
+        const double a = std::sin(half_latitude) * std::sin(half_latitude)
+            + std::cos(from_latitude) * std::cos(to_latitude) * std::sin(half_longitude) * std::sin(half_longitude);
+        const double metres = 2.0 * 6372797.560856 * std::asin(std::min(1.0, std::sqrt(a)));
+        const double factor = to.lon.__value > from.lon.__value ? eastward_factor_ : 1.0;
+        return std::round(metres / metres_per_second_ * factor * 10.0) / 10.0;
+    }
+
+    double metres_per_second_;
+    double eastward_factor_;
+};
+
+// OSRM snapping hints of the coordinates of one query run, one base64 hint per coordinate row, empty while unknown.
+// Queries pass the known hints to OSRM, which then skips the nearest edge lookup for those coordinates, and store
+// the hints OSRM returns for the others, so every coordinate is snapped at most once per run (see HintsCache).
+struct SnappingHints {
+    std::vector<std::string> hints;
+    std::mutex mutex;
+
+    explicit SnappingHints(size_t size) : hints(size) {
+    }
+};
+
+// Queries the durations from every coordinate listed in sources to every coordinate listed in destinations,
+// the result has one row per sources entry and one column per destinations entry.
+// With tile_size > 0 both lists are split into blocks of tile_size and every (source block, destination block) pair is queried
+// separately on thread_count threads. A query only carries the coordinates of its two blocks, so OSRM snaps 2*tile_size points
+// per tile instead of all of them. The tile durations are stitched into one matrix with the same layout as a single query.
+// With hints (indexed like coordinates) the queries use and fill the snapping hints.
+DurationMatrix query_table_durations(const RoutingBackend& backend, const std::vector<osrm::util::Coordinate>& coordinates,
+    const std::vector<size_t>& sources, const std::vector<size_t>& destinations, size_t tile_size, unsigned thread_count, SnappingHints* hints = nullptr) {
+    using namespace osrm;
+
+    const size_t source_tile_size = tile_size == 0 ? std::max<size_t>(sources.size(), 1) : tile_size;
+    const size_t destination_tile_size = tile_size == 0 ? std::max<size_t>(destinations.size(), 1) : tile_size;
+    const size_t source_block_count = (sources.size() + source_tile_size - 1) / source_tile_size;
+    const size_t destination_block_count = (destinations.size() + destination_tile_size - 1) / destination_tile_size;
+    const bool same_lists = sources == destinations;
+
+    DurationMatrix durations_matrix;
+    durations_matrix.rows = sources.size();
+    durations_matrix.columns = destinations.size();
+    durations_matrix.values.resize(durations_matrix.rows * durations_matrix.columns);
+
+    parallel_for(source_block_count * destination_block_count, thread_count, [&](size_t tile) {
+        const size_t source_begin = tile / destination_block_count * source_tile_size;
+        const size_t source_end = std::min(source_begin + source_tile_size, sources.size());
+        const size_t destination_begin = tile % destination_block_count * destination_tile_size;
+        const size_t destination_end = std::min(destination_begin + destination_tile_size, destinations.size());
+
+        TableParameters tile_params;
+        std::vector<size_t> tile_rows;
+        for (size_t i = source_begin; i < source_end; i++) {
+            tile_params.sources.push_back(tile_params.coordinates.size());
+            tile_params.coordinates.push_back(coordinates.at(sources[i]));
+            tile_rows.push_back(sources[i]);
+        }
+        for (size_t i = destination_begin; i < destination_end; i++) {
+            if (same_lists && destination_begin == source_begin) {
+                tile_params.destinations.push_back(i - destination_begin);
+            }
+            else {
+                tile_params.destinations.push_back(tile_params.coordinates.size());
+                tile_params.coordinates.push_back(coordinates.at(destinations[i]));
+                tile_rows.push_back(destinations[i]);
+            }
+        }
+
+        // hints are only serialised into the result when they are stored
+        tile_params.generate_hints = hints != nullptr;
+        std::vector<std::string> tile_hints;
+        if (hints != nullptr) {
+            std::lock_guard<std::mutex> lock(hints->mutex);
+            for (const size_t row : tile_rows) {
+                if (hints->hints[row].empty()) {
+                    tile_params.hints.emplace_back();
+                }
+                else {
+                    tile_params.hints.emplace_back(engine::Hint::FromBase64(hints->hints[row]));
+                }
+            }
+        }
+
+        const DurationMatrix tile_durations = backend.table(tile_params, hints != nullptr ? &tile_hints : nullptr);
+
+        if (hints != nullptr) {
+            std::lock_guard<std::mutex> lock(hints->mutex);
+            for (size_t i = 0; i < tile_rows.size(); i++) {
+                if (hints->hints[tile_rows[i]].empty()) {
+                    hints->hints[tile_rows[i]] = tile_hints[i];
+                }
+            }
+        }
+
+        for (size_t row = 0; row < tile_durations.rows; row++) {
+            std::copy(tile_durations.row(row), tile_durations.row(row) + tile_durations.columns,
+                durations_matrix.values.begin() + (source_begin + row) * durations_matrix.columns + destination_begin);
+        }
+    });
+
+    return durations_matrix;
+}
+
+// Jobs that share a coordinate share one row and column of the routed matrix. uniqueRows lists the job row of each
+// distinct coordinate in order of first occurrence, uniqueOf maps every job row to its index in uniqueRows.
+struct CoordinateDedup {
+    std::vector<size_t> uniqueRows;
+    std::vector<size_t> uniqueOf;
+};
+
+// Groups identical coordinates, or with tolerance_metres > 0 every coordinate within that distance of the first
+// coordinate of a group (found through a grid of tolerance sized cells).
+CoordinateDedup dedup_coordinates(const std::vector<osrm::util::Coordinate>& coordinates, double tolerance_metres) {
+    CoordinateDedup dedup;
+    dedup.uniqueOf.resize(coordinates.size());
+
+    auto key = [](std::int64_t x, std::int64_t y) {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+    };
+
+    if (!(tolerance_metres > 0)) {
+        std::unordered_map<std::uint64_t, size_t> uniqueOfCoordinate;
+        for (size_t row = 0; row < coordinates.size(); row++) {
+            const auto unique = uniqueOfCoordinate.emplace(key(static_cast<std::int32_t>(coordinates[row].lon.__value), static_cast<std::int32_t>(coordinates[row].lat.__value)), dedup.uniqueRows.size());
+            if (unique.second) {
+                dedup.uniqueRows.push_back(row);
+            }
+            dedup.uniqueOf[row] = unique.first->second;
+        }
+        return dedup;
+    }
+
+    const double metres_per_degree = 111319.49;
+    const double radians = 3.14159265358979323846 / 180.0;
+    std::vector<double> x(coordinates.size());
+    std::vector<double> y(coordinates.size());
+    std::unordered_map<std::uint64_t, std::vector<size_t> > grid;
+    for (size_t row = 0; row < coordinates.size(); row++) {
+        const double latitude = static_cast<double>(coordinates[row].lat.__value) / 1000000.0;
+        x[row] = static_cast<double>(coordinates[row].lon.__value) / 1000000.0 * metres_per_degree * std::cos(latitude * radians);
+        y[row] = latitude * metres_per_degree;
+        const auto cell_x = static_cast<std::int64_t>(std::floor(x[row] / tolerance_metres));
+        const auto cell_y = static_cast<std::int64_t>(std::floor(y[row] / tolerance_metres));
+
+        size_t found = dedup.uniqueRows.size();
+        for (std::int64_t dx = -1; dx <= 1 && found == dedup.uniqueRows.size(); dx++) {
+            for (std::int64_t dy = -1; dy <= 1 && found == dedup.uniqueRows.size(); dy++) {
+                const auto cell = grid.find(key(cell_x + dx, cell_y + dy));
+                if (cell == grid.end()) {
+                    continue;
+                }
+                for (const size_t unique : cell->second) {
+                    const size_t uniqueRow = dedup.uniqueRows[unique];
+                    if (std::hypot(x[uniqueRow] - x[row], y[uniqueRow] - y[row]) <= tolerance_metres) {
+                        found = unique;
+                        break;
+                    }
+                }
+            }
+        }
+        if (found == dedup.uniqueRows.size()) {
+            grid[key(cell_x, cell_y)].push_back(found);
+            dedup.uniqueRows.push_back(row);
+        }
+        dedup.uniqueOf[row] = found;
+    }
+    return dedup;
+}
+
+// --no-dedup: every job keeps its own row and column.
+CoordinateDedup identity_dedup(size_t size) {
+    CoordinateDedup dedup;
+    dedup.uniqueRows.resize(size);
+    std::iota(dedup.uniqueRows.begin(), dedup.uniqueRows.end(), 0);
+    dedup.uniqueOf = dedup.uniqueRows;
+    return dedup;
+}
+
+// How workdrivesymc turns the two directions of a pair into the one duration LOWER_DIAG_ROW holds.
+// none keeps the row -> column direction as routed, the others route both directions and fold them.
+enum class Symmetrisation {
+    none,
+    min,
+    max,
+    mean
+};
+
+Symmetrisation parse_symmetrisation(const std::string& value) {
+    if (value == "min") {
+        return Symmetrisation::min;
+    }
+    if (value == "max") {
+        return Symmetrisation::max;
+    }
+    if (value == "mean") {
+        return Symmetrisation::mean;
+    }
+    throw std::runtime_error("invalid value for --symmetrise: " + value + ". Supported values: min, max, mean.");
+}
+
+// A single block would route the whole square, so --triangle without --tile-size uses blocks of this size.
+const size_t default_triangle_tile_size = 1000;
+
+// Durations between all coordinates as a lower triangle matrix. The coordinates are split into blocks of tile_size
+// and only the (source block, destination block) pairs on or below the diagonal are queried, on thread_count threads,
+// so for Symmetrisation::none OSRM computes and the matrix stores about half of the square.
+// With min, max or mean every block pair below the diagonal is queried in both directions once and folded.
+DurationMatrix query_lower_triangle_durations(const RoutingBackend& backend, const std::vector<osrm::util::Coordinate>& coordinates,
+    size_t tile_size, unsigned thread_count, Symmetrisation symmetrisation, SnappingHints* hints = nullptr) {
+    const size_t size = coordinates.size();
+    const size_t block_size = tile_size == 0 ? std::max<size_t>(size, 1) : tile_size;
+    const size_t block_count = (size + block_size - 1) / block_size;
+
+    DurationMatrix durations_matrix;
+    durations_matrix.rows = size;
+    durations_matrix.columns = size;
+    durations_matrix.lower_triangle = true;
+    durations_matrix.values.resize(size * (size + 1) / 2);
+
+    std::vector<std::pair<size_t, size_t> > block_pairs;
+    for (size_t source_block = 0; source_block < block_count; source_block++) {
+        for (size_t destination_block = 0; destination_block <= source_block; destination_block++) {
+            block_pairs.emplace_back(source_block, destination_block);
+        }
+    }
+
+    auto fold = [symmetrisation](float forward, float backward) {
+        switch (symmetrisation) {
+        case Symmetrisation::min:
+            return std::min(forward, backward);
+        case Symmetrisation::max:
+            return std::max(forward, backward);
+        case Symmetrisation::mean: {
+            // averaged in whole deciseconds and rounded once (half away from zero), so DurationMatrix::seconds reads back
+            // exactly that decisecond and the float error of the two halves cannot tip the rounding
+            const long deciseconds = std::lround((std::lround(forward * 10.0) + std::lround(backward * 10.0)) / 2.0);
+            return static_cast<float>(deciseconds / 10.0);
+        }
+        default:
+            return forward;
+        }
+    };
+
+    parallel_for(block_pairs.size(), thread_count, [&](size_t pair) {
+        const size_t source_begin = block_pairs[pair].first * block_size;
+        const size_t destination_begin = block_pairs[pair].second * block_size;
+        std::vector<size_t> sources(std::min(block_size, size - source_begin));
+        std::vector<size_t> destinations(std::min(block_size, size - destination_begin));
+        std::iota(sources.begin(), sources.end(), source_begin);
+        std::iota(destinations.begin(), destinations.end(), destination_begin);
+
+        const bool diagonal = source_begin == destination_begin;
+        const DurationMatrix forward = query_table_durations(backend, coordinates, sources, destinations, 0, 1, hints);
+        DurationMatrix backward;
+        if (symmetrisation != Symmetrisation::none && !diagonal) {
+            backward = query_table_durations(backend, coordinates, destinations, sources, 0, 1, hints);
+        }
+
+        for (size_t row = 0; row < sources.size(); row++) {
+            float* cells = durations_matrix.row_begin(source_begin + row) + destination_begin;
+            const size_t count = diagonal ? row + 1 : destinations.size();
+            for (size_t column = 0; column < count; column++) {
+                const float forward_duration = forward.row(row)[column];
+                if (symmetrisation == Symmetrisation::none) {
+                    cells[column] = forward_duration;
+                }
+                else {
+                    cells[column] = fold(forward_duration, diagonal ? forward.row(column)[row] : backward.row(column)[row]);
+                }
+            }
+        }
+    });
+
+    return durations_matrix;
+}
+
+// Job level lower triangle from the lower triangle of the deduplicated coordinates, which only holds u -> v for u >= v.
+// A job that repeats an earlier coordinate can come after jobs whose coordinates were first seen later, its row needs
+// the other direction towards them. Those pairs are routed as one more table before the rows are expanded.
+// The unique indices follow the order of first occurrence, so the uniques before a job row are 0 .. seen-1.
+DurationMatrix expand_lower_triangle(const DurationMatrix& uniqueDurations, const CoordinateDedup& dedup, const RoutingBackend& backend,
+    const std::vector<osrm::util::Coordinate>& uniqueCoordinates, size_t tile_size, unsigned thread_count, SnappingHints* hints = nullptr) {
+    const size_t size = dedup.uniqueOf.size();
+    const size_t no_index = static_cast<size_t>(-1);
+
+    std::vector<size_t> flippedIndex(dedup.uniqueRows.size(), no_index);
+    std::vector<size_t> flippedSources;
+    size_t first_column = dedup.uniqueRows.size();
+    size_t end_column = 0;
+    size_t seen = 0;
+    for (size_t row = 0; row < size; row++) {
+        const size_t unique = dedup.uniqueOf[row];
+        if (unique == seen) {
+            seen++;
+            continue;
+        }
+        if (unique + 1 < seen) {
+            if (flippedIndex[unique] == no_index) {
+                flippedIndex[unique] = flippedSources.size();
+                flippedSources.push_back(unique);
+            }
+            first_column = std::min(first_column, unique + 1);
+            end_column = std::max(end_column, seen);
+        }
+    }
+
+    DurationMatrix flipped;
+    if (!flippedSources.empty()) {
+        std::vector<size_t> destinations(end_column - first_column);
+        std::iota(destinations.begin(), destinations.end(), first_column);
+        flipped = query_table_durations(backend, uniqueCoordinates, flippedSources, destinations, tile_size, thread_count, hints);
+        std::cout << "dedup: " << flippedSources.size() << " repeated coordinates routed again towards later ones" << std::endl;
+    }
+
+    DurationMatrix expanded;
+    expanded.rows = size;
+    expanded.columns = size;
+    expanded.lower_triangle = true;
+    expanded.values.resize(size * (size + 1) / 2);
+    parallel_for(size, thread_count, [&](size_t row) {
+        float* cells = expanded.row_begin(row);
+        const size_t from = dedup.uniqueOf[row];
+        for (size_t column = 0; column <= row; column++) {
+            const size_t to = dedup.uniqueOf[column];
+            cells[column] = from >= to ? uniqueDurations.row(from)[to] : flipped.row(flippedIndex[from])[to - first_column];
+        }
+    });
+    return expanded;
+}
+
+// CPU time (user and kernel) and peak resident set size of the whole process so far.
+struct ProcessUsage {
+    double cpu_seconds = 0;
+    std::uint64_t peak_rss_bytes = 0;
+};
+
+ProcessUsage current_process_usage() {
+    ProcessUsage usage;
+#ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+        auto seconds = [](const FILETIME& time) {
+            return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+        };
+        usage.cpu_seconds = seconds(kernel_time) + seconds(user_time);
+    }
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        usage.peak_rss_bytes = counters.PeakWorkingSetSize;
+    }
+#else
+    struct rusage resources;
+    if (getrusage(RUSAGE_SELF, &resources) == 0) {
+        usage.cpu_seconds = resources.ru_utime.tv_sec + resources.ru_utime.tv_usec / 1e6 + resources.ru_stime.tv_sec + resources.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+        usage.peak_rss_bytes = static_cast<std::uint64_t>(resources.ru_maxrss);
+#else
+        usage.peak_rss_bytes = static_cast<std::uint64_t>(resources.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return usage;
+}
+
+std::string json_string(const std::string& text) {
+    std::string quoted = "\"";
+    for (const char symbol : text) {
+        if (symbol == '"' || symbol == '\\') {
+            quoted += '\\';
+            quoted += symbol;
+        }
+        else if (static_cast<unsigned char>(symbol) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", symbol);
+            quoted += escaped;
+        }
+        else {
+            quoted += symbol;
+        }
+    }
+    return quoted + "\"";
+}
+
+// --stats: wall time, CPU time and peak RSS at the end of each phase of a run, plus counts, written as JSON to
+// OUTPUT.stats.json when the run ends (also when it fails, then with "completed": false).
+// CPU time and peak RSS are process wide, in batch mode they include the commands running at the same time. The peak RSS
+// is a high-water mark that never goes down, so a phase reports it as cumulative_peak_rss_bytes and, as its own share,
+// by how much it raised the mark (peak_rss_growth_bytes). bytes_written sums OUTPUT and every file registered with written().
+class RunStats {
+public:
+    RunStats(bool enabled, const std::string& outputFilename, const std::string& mode)
+        : enabled_(enabled), outputFilename_(outputFilename), mode_(mode), uncaught_exceptions_(std::uncaught_exceptions()),
+          start_(Clock::now()), start_usage_(enabled ? current_process_usage() : ProcessUsage()) {
+    }
+
+    RunStats(const RunStats&) = delete;
+    RunStats& operator=(const RunStats&) = delete;
+
+    ~RunStats() {
+        if (!enabled_) {
+            return;
+        }
+        try {
+            end();
+            std::uint64_t bytes = 0;
+            bytes_of(outputFilename_, bytes);
+            for (const auto& filename : writtenFilenames_) {
+                bytes_of(filename, bytes);
+            }
+            set("bytes_written", static_cast<double>(bytes));
+            write(std::uncaught_exceptions() == uncaught_exceptions_);
+        }
+        catch (std::exception& ex) {
+            std::cerr << "error writing stats file: " << ex.what() << std::endl;
+        }
+    }
+
+    bool enabled() const {
+        return enabled_;
+    }
+
+    // Another file the run writes besides OUTPUT (binary matrix, run settings, --outputs variants, ...), counted in
+    // bytes_written with its size at the end of the run. Safe to call from several threads.
+    void written(const std::string& filename) {
+        if (!enabled_ || filename == outputFilename_) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(counts_mutex_);
+        if (std::find(writtenFilenames_.begin(), writtenFilenames_.end(), filename) == writtenFilenames_.end()) {
+            writtenFilenames_.push_back(filename);
+        }
+    }
+
+    // Ends the running phase (if any) and starts the next one.
+    void begin(const std::string& phase) {
+        if (!enabled_) {
+            return;
+        }
+        end();
+        phase_ = phase;
+        phase_start_ = Clock::now();
+        phase_start_usage_ = current_process_usage();
+    }
+
+    void end() {
+        if (!enabled_ || phase_.empty()) {
+            return;
+        }
+        const ProcessUsage usage = current_process_usage();
+        phases_.push_back({ phase_, std::chrono::duration<double>(Clock::now() - phase_start_).count(),
+            usage.cpu_seconds - phase_start_usage_.cpu_seconds, usage.peak_rss_bytes, usage.peak_rss_bytes - phase_start_usage_.peak_rss_bytes });
+        phase_.clear();
+    }
+
+    void set(const std::string& name, double value) {
+        if (!enabled_) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(counts_mutex_);
+        for (auto& count : counts_) {
+            if (count.first == name) {
+                count.second = value;
+                return;
+            }
+        }
+        counts_.emplace_back(name, value);
+    }
+
+    // Safe to call from several threads.
+    void add(const std::string& name, double value) {
+        if (!enabled_) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(counts_mutex_);
+        for (auto& count : counts_) {
+            if (count.first == name) {
+                count.second += value;
+                return;
+            }
+        }
+        counts_.emplace_back(name, value);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name;
+        double wall_seconds;
+        double cpu_seconds;
+        std::uint64_t cumulative_peak_rss_bytes;
+        std::uint64_t peak_rss_growth_bytes;
+    };
+
+    static void bytes_of(const std::string& filename, std::uint64_t& bytes) {
+        std::error_code error;
+        const auto size = std::filesystem::file_size(filename, error);
+        if (!error) {
+            bytes += size;
+        }
+    }
+
+    void write(bool completed) const {
+        const std::string filename = outputFilename_ + ".stats.json";
+        std::ofstream statsFile(filename);
+        if (!statsFile.is_open()) {
+            throw std::runtime_error("error writing stats file " + filename);
+        }
+        const ProcessUsage usage = current_process_usage();
+        statsFile << std::setprecision(9);
+        statsFile << "{" << '\n';
+        statsFile << "  \"output\": " << json_string(outputFilename_) << "," << '\n';
+        statsFile << "  \"mode\": " << json_string(mode_) << "," << '\n';
+        statsFile << "  \"completed\": " << (completed ? "true" : "false") << "," << '\n';
+        statsFile << "  \"wall_seconds\": " << std::chrono::duration<double>(Clock::now() - start_).count() << "," << '\n';
+        statsFile << "  \"cpu_seconds\": " << usage.cpu_seconds - start_usage_.cpu_seconds << "," << '\n';
+        statsFile << "  \"peak_rss_bytes\": " << usage.peak_rss_bytes << "," << '\n';
+        statsFile << "  \"phases\": [";
+        for (size_t i = 0; i < phases_.size(); i++) {
+            statsFile << (i == 0 ? "" : ",") << '\n' << "    {\"name\": " << json_string(phases_[i].name)
+                << ", \"wall_seconds\": " << phases_[i].wall_seconds << ", \"cpu_seconds\": " << phases_[i].cpu_seconds
+                << ", \"cumulative_peak_rss_bytes\": " << phases_[i].cumulative_peak_rss_bytes
+                << ", \"peak_rss_growth_bytes\": " << phases_[i].peak_rss_growth_bytes << "}";
+        }
+        statsFile << '\n' << "  ]," << '\n';
+        statsFile << "  \"counts\": {";
+        for (size_t i = 0; i < counts_.size(); i++) {
+            statsFile << (i == 0 ? "" : ",") << '\n' << "    " << json_string(counts_[i].first) << ": " << counts_[i].second;
+        }
+        statsFile << '\n' << "  }" << '\n';
+        statsFile << "}" << '\n';
+    }
+
+    bool enabled_;
+    std::string outputFilename_;
+    std::string mode_;
+    int uncaught_exceptions_;
+    Clock::time_point start_;
+    ProcessUsage start_usage_;
+    std::string phase_;
+    Clock::time_point phase_start_;
+    ProcessUsage phase_start_usage_;
+    std::vector<Phase> phases_;
+    std::mutex counts_mutex_;
+    std::vector<std::pair<std::string, double> > counts_;
+    std::vector<std::string> writtenFilenames_;
+};
+
+// Jobs of an INPUT file as columns in file order, entry i of every column belongs to the job in matrix row i.
+struct JobColumns {
+    std::vector<int> ids;
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    std::vector<double> score1;
+    std::vector<double> score2;
+
+    size_t size() const {
+        return ids.size();
+    }
+
+    std::vector<osrm::util::Coordinate> coordinates() const {
+        std::vector<osrm::util::Coordinate> coordinates;
+        coordinates.reserve(size());
+        for (size_t row = 0; row < size(); row++) {
+            coordinates.push_back({ osrm::util::FloatLongitude{longitudes[row]}, osrm::util::FloatLatitude{latitudes[row]} });
+        }
+        return coordinates;
+    }
+};
+
+// Number parsing of parse_jobs: blanks before a value are skipped like operator>> does, nullptr marks a malformed value.
+const char* skip_blanks(const char* position, const char* end) {
+    while (position != end && std::isspace(static_cast<unsigned char>(*position))) {
+        position++;
+    }
+    return position;
+}
+
+template <typename Number>
+const char* parse_field(const char* position, const char* end, Number& value) {
+    position = skip_blanks(position, end);
+    if (position != end && *position == '+') {
+        position++;
+    }
+    const auto result = std::from_chars(position, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+const char* parse_separator(const char* position, const char* end) {
+    position = skip_blanks(position, end);
+    return position != end && *position == ',' ? position + 1 : nullptr;
+}
+
+// Parses the "id,latitude,longitude,score1,score2" lines of INPUT text straight into columns, without copying lines.
+// on_line sees every line (to echo the input), on_skipped_line the lines whose first non-blank character is not a digit
+// (headers, comments). A malformed job line throws.
+template <typename LineFunction, typename SkippedLineFunction>
+void parse_jobs(const char* begin, const char* end, JobColumns& jobs, LineFunction on_line, SkippedLineFunction on_skipped_line) {
+    const char* line_begin = begin;
+    while (line_begin != end) {
+        const char* newline = static_cast<const char*>(std::memchr(line_begin, '\n', end - line_begin));
+        const char* next_line = newline == nullptr ? end : newline + 1;
+        const char* line_end = newline == nullptr ? end : newline;
+#ifdef _WIN32
+        // text mode streams on Windows drop the \r of \r\n line ends
+        if (line_end != line_begin && line_end[-1] == '\r') {
+            line_end--;
+        }
+#endif
+        const std::string_view line(line_begin, line_end - line_begin);
+        on_line(line);
+
+        const char* position = skip_blanks(line_begin, line_end);
+        if (position == line_end || !std::isdigit(static_cast<unsigned char>(*position))) {
+            on_skipped_line(line);
+            line_begin = next_line;
+            continue;
+        }
+
+        int uniqueJobID;
+        double latitude;
+        double longitude;
+        double score1;
+        double score2;
+        position = parse_field(position, line_end, uniqueJobID);
+        position = position ? parse_separator(position, line_end) : nullptr;
+        position = position ? parse_field(position, line_end, latitude) : nullptr;
+        position = position ? parse_separator(position, line_end) : nullptr;
+        position = position ? parse_field(position, line_end, longitude) : nullptr;
+        position = position ? parse_separator(position, line_end) : nullptr;
+        position = position ? parse_field(position, line_end, score1) : nullptr;
+        position = position ? parse_separator(position, line_end) : nullptr;
+        position = position ? parse_field(position, line_end, score2) : nullptr;
+        if (position == nullptr) {
+            throw std::runtime_error("invalid input line: " + std::string(line));
+        }
+
+        jobs.ids.push_back(uniqueJobID);
+        jobs.latitudes.push_back(latitude);
+        jobs.longitudes.push_back(longitude);
+        jobs.score1.push_back(score1);
+        jobs.score2.push_back(score2);
+        line_begin = next_line;
+    }
+}
+
+// istringstream based parsing of one INPUT line as the tool did before parse_jobs, kept as the baseline of the benchparse mode.
+// Returns false for lines that do not start with a digit (headers, comments), throws on malformed job lines.
+bool parse_job_line(const std::string& line, int& uniqueJobID, double& latitude, double& longitude, double& score1, double& score2) {
+    {
+        std::istringstream lineCheckStream(line);
+        char firstSymbol = '\0';
+        lineCheckStream >> firstSymbol;
+        if (!std::isdigit(firstSymbol)) {
+            return false;
+        }
+    }
+
+    std::istringstream lineStream(line);
+    char separator1;
+    char separator2;
+    char separator3;
+    char separator4;
+
+    lineStream >> uniqueJobID >> separator1 >> latitude >> separator2 >> longitude;
+    lineStream >> separator3 >> score1 >> separator4 >> score2;
+
+    if (separator1 != ',' || separator2 != ',' || separator3 != ',' || separator4 != ',') {
+        throw std::runtime_error("invalid input line: " + line);
+    }
+    return true;
+}
+
+// Computes one output matrix cell in minutes from the routed duration in seconds.
+// workdrive adds the work duration of the destination job, workdrivesymc adds half of both work durations.
+long output_cell(WorkMode work_mode, double durationSeconds, double dampeningFactor, double workFromDuration, double workToDuration) {
+    double durationInMinutes = durationSeconds * dampeningFactor / 60.0;
+    if (work_mode == WorkMode::workdrive) {
+        durationInMinutes += workToDuration;
+    }
+    if (work_mode == WorkMode::workdrivesymc) {
+        durationInMinutes += workToDuration / 2.0;
+        durationInMinutes += workFromDuration / 2.0;
+    }
+    return std::lround(durationInMinutes);
+}
+
+// Implementations of output_cells, the best one the CPU supports is chosen at runtime.
+enum class CellKernel {
+    scalar,
+    sse2,
+    avx2
+};
+
+const char* cell_kernel_name(CellKernel kernel) {
+    return kernel == CellKernel::avx2 ? "avx2" : kernel == CellKernel::sse2 ? "sse2" : "scalar";
+}
+
+#ifdef TABLE_X86_64
+bool cpu_supports_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+CellKernel best_cell_kernel() {
+#ifdef TABLE_X86_64
+    static const CellKernel kernel = cpu_supports_avx2() ? CellKernel::avx2 : CellKernel::sse2;
+    return kernel;
+#else
+    return CellKernel::scalar;
+#endif
+}
+
+void output_cells_scalar(WorkMode work_mode, const float* durations, size_t count, double dampeningFactor, double workFromDuration, const double* workToDurations, long* cells) {
+    for (size_t i = 0; i < count; i++) {
+        cells[i] = output_cell(work_mode, DurationMatrix::seconds(durations[i]), dampeningFactor, workFromDuration, workToDurations[i]);
+    }
+}
+
+#ifdef TABLE_X86_64
+// The vector kernels compute in double with the operations of output_cell in the same order, so every cell is bit for bit
+// the scalar result. std::round and std::lround round half away from zero, emulated as trunc(x) plus the sign of x where
+// |x - trunc(x)| >= 0.5, which is exact. Lanes with values of 2^30 and more (or NaN) are left to the scalar code,
+// so the truncation through 32 bit integers of SSE2 and the int32 conversion of the results stay exact.
+const double cell_kernel_limit = 1073741824.0;
+
+inline __m128d round_half_away_sse2(__m128d x) {
+    const __m128d truncated = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+    const __m128d sign_bit = _mm_set1_pd(-0.0);
+    const __m128d away = _mm_or_pd(_mm_and_pd(x, sign_bit), _mm_set1_pd(1.0));
+    const __m128d fraction = _mm_andnot_pd(sign_bit, _mm_sub_pd(x, truncated));
+    return _mm_add_pd(truncated, _mm_and_pd(_mm_cmpge_pd(fraction, _mm_set1_pd(0.5)), away));
+}
+
+inline bool in_kernel_range_sse2(__m128d x) {
+    return _mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(_mm_set1_pd(-0.0), x), _mm_set1_pd(cell_kernel_limit))) == 3;
+}
+
+void output_cells_sse2(WorkMode work_mode, const float* durations, size_t count, double dampeningFactor, double workFromDuration, const double* workToDurations, long* cells) {
+    const __m128d ten = _mm_set1_pd(10.0);
+    const __m128d sixty = _mm_set1_pd(60.0);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d dampening = _mm_set1_pd(dampeningFactor);
+    const __m128d workFromHalf = _mm_set1_pd(workFromDuration / 2.0);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128d tenths = _mm_mul_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(durations + i)))), ten);
+        if (!in_kernel_range_sse2(tenths)) {
+            output_cells_scalar(work_mode, durations + i, 2, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+            continue;
+        }
+        __m128d minutes = _mm_div_pd(_mm_mul_pd(_mm_div_pd(round_half_away_sse2(tenths), ten), dampening), sixty);
+        if (work_mode == WorkMode::workdrive) {
+            minutes = _mm_add_pd(minutes, _mm_loadu_pd(workToDurations + i));
+        }
+        else if (work_mode == WorkMode::workdrivesymc) {
+            minutes = _mm_add_pd(_mm_add_pd(minutes, _mm_mul_pd(_mm_loadu_pd(workToDurations + i), half)), workFromHalf);
+        }
+        if (!in_kernel_range_sse2(minutes)) {
+            output_cells_scalar(work_mode, durations + i, 2, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+            continue;
+        }
+        std::int32_t rounded[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rounded), _mm_cvttpd_epi32(round_half_away_sse2(minutes)));
+        cells[i] = rounded[0];
+        cells[i + 1] = rounded[1];
+    }
+    output_cells_scalar(work_mode, durations + i, count - i, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+}
+
+TABLE_TARGET_AVX2 inline __m256d round_half_away_avx2(__m256d x) {
+    const __m256d truncated = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d away = _mm256_or_pd(_mm256_and_pd(x, sign_bit), _mm256_set1_pd(1.0));
+    const __m256d fraction = _mm256_andnot_pd(sign_bit, _mm256_sub_pd(x, truncated));
+    return _mm256_add_pd(truncated, _mm256_and_pd(_mm256_cmp_pd(fraction, _mm256_set1_pd(0.5), _CMP_GE_OQ), away));
+}
+
+TABLE_TARGET_AVX2 inline bool in_kernel_range_avx2(__m256d x) {
+    return _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), x), _mm256_set1_pd(cell_kernel_limit), _CMP_LT_OQ)) == 15;
+}
+
+TABLE_TARGET_AVX2 void output_cells_avx2(WorkMode work_mode, const float* durations, size_t count, double dampeningFactor, double workFromDuration, const double* workToDurations, long* cells) {
+    const __m256d ten = _mm256_set1_pd(10.0);
+    const __m256d sixty = _mm256_set1_pd(60.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d dampening = _mm256_set1_pd(dampeningFactor);
+    const __m256d workFromHalf = _mm256_set1_pd(workFromDuration / 2.0);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m256d tenths = _mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(durations + i)), ten);
+        if (!in_kernel_range_avx2(tenths)) {
+            output_cells_scalar(work_mode, durations + i, 4, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+            continue;
+        }
+        __m256d minutes = _mm256_div_pd(_mm256_mul_pd(_mm256_div_pd(round_half_away_avx2(tenths), ten), dampening), sixty);
+        if (work_mode == WorkMode::workdrive) {
+            minutes = _mm256_add_pd(minutes, _mm256_loadu_pd(workToDurations + i));
+        }
+        else if (work_mode == WorkMode::workdrivesymc) {
+            minutes = _mm256_add_pd(_mm256_add_pd(minutes, _mm256_mul_pd(_mm256_loadu_pd(workToDurations + i), half)), workFromHalf);
+        }
+        if (!in_kernel_range_avx2(minutes)) {
+            output_cells_scalar(work_mode, durations + i, 4, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+            continue;
+        }
+        const __m128i rounded = _mm256_cvttpd_epi32(round_half_away_avx2(minutes));
+        if (sizeof(long) == sizeof(std::int64_t)) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(cells + i), _mm256_cvtepi32_epi64(rounded));
+        }
+        else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cells + i), rounded);
+        }
+    }
+    output_cells_scalar(work_mode, durations + i, count - i, dampeningFactor, workFromDuration, workToDurations + i, cells + i);
+}
+#endif
+
+// Output cells of count contiguous routed durations of one row: cells[i] = output_cell(work_mode, seconds of durations[i],
+// dampeningFactor, workFromDuration, workToDurations[i]), with the work durations as a dense array indexed by row.
+void output_cells(CellKernel kernel, WorkMode work_mode, const float* durations, size_t count, double dampeningFactor, double workFromDuration,
+    const double* workToDurations, long* cells) {
+#ifdef TABLE_X86_64
+    if (kernel == CellKernel::avx2) {
+        output_cells_avx2(work_mode, durations, count, dampeningFactor, workFromDuration, workToDurations, cells);
+        return;
+    }
+    if (kernel == CellKernel::sse2) {
+        output_cells_sse2(work_mode, durations, count, dampeningFactor, workFromDuration, workToDurations, cells);
+        return;
+    }
+#endif
+    output_cells_scalar(work_mode, durations, count, dampeningFactor, workFromDuration, workToDurations, cells);
+}
+
+// --outputs=MODE:DAMPENING:FILE,...: further outputs of drive, workdrive or workdrivesymc written from the routed matrix
+// of the command. FILE is everything after the second colon, so it may hold a drive letter. A workdrivesymc variant may give
+// its own COST_LIMIT as workdrivesymc:DAMPENING:COST_LIMIT:FILE, without it the variant takes the limit of a workdrivesymc
+// command.
+struct OutputVariant {
+    std::string modeName;
+    WorkMode mode;
+    double dampeningFactor;
+    // empty when not given
+    std::string costLimit;
+    std::string filename;
+};
+
+std::vector<OutputVariant> parse_output_variants(const std::string& value) {
+    std::vector<OutputVariant> variants;
+    std::istringstream list(value);
+    for (std::string item; std::getline(list, item, ',');) {
+        const size_t modeEnd = item.find(':');
+        const size_t dampeningEnd = modeEnd == std::string::npos ? std::string::npos : item.find(':', modeEnd + 1);
+        if (dampeningEnd == std::string::npos || dampeningEnd + 1 == item.size()) {
+            throw std::runtime_error("invalid value for --outputs: " + item + ". Expected MODE:DAMPENING:FILE");
+        }
+        OutputVariant variant;
+        variant.modeName = item.substr(0, modeEnd);
+        variant.mode = parse_work_mode(variant.modeName);
+        if (variant.mode != WorkMode::drive && variant.mode != WorkMode::workdrive && variant.mode != WorkMode::workdrivesymc) {
+            throw std::runtime_error("invalid mode in --outputs: " + variant.modeName + ". Supported modes: drive, workdrive, workdrivesymc.");
+        }
+        try {
+            variant.dampeningFactor = std::stod(item.substr(modeEnd + 1, dampeningEnd - modeEnd - 1));
+        }
+        catch (std::exception&) {
+            throw std::runtime_error("invalid dampening factor in --outputs: " + item);
+        }
+        variant.filename = item.substr(dampeningEnd + 1);
+        const size_t costLimitEnd = variant.filename.find(':');
+        if (variant.mode == WorkMode::workdrivesymc && costLimitEnd != std::string::npos && costLimitEnd != 0
+            && variant.filename.find_first_not_of("0123456789") == costLimitEnd) {
+            variant.costLimit = variant.filename.substr(0, costLimitEnd);
+            variant.filename = variant.filename.substr(costLimitEnd + 1);
+            if (variant.filename.empty()) {
+                throw std::runtime_error("invalid value for --outputs: " + item + ". Expected workdrivesymc:DAMPENING:COST_LIMIT:FILE");
+            }
+        }
+        variants.push_back(variant);
+    }
+    return variants;
+}
+
+// Fills the output cells of one matrix row: all columns for drive and workdrive, columns 0..row for workdrivesymc (LOWER_DIAG_ROW).
+using MatrixRowCells = std::function<void(size_t row, std::vector<long>& cells)>;
+
+enum class MatrixTextFormat {
+    // "D,  c0,\tc1,\t...,\tcN," rows of drive and workdrive
+    drive,
+    // space separated lower triangle with diagonal of workdrivesymc
+    lower_diag_row
+};
+
+// Writes the matrix rows first_row..end_row-1 of a size x size matrix in the given text format. Rows are formatted with
+// std::to_chars into one buffer per chunk of rows, the chunks are formatted on thread_count threads and written in row order
+// with one write call each.
+void write_matrix_rows(std::ostream& outputFile, size_t size, size_t first_row, size_t end_row, MatrixTextFormat format, const MatrixRowCells& row_cells, unsigned thread_count) {
+    const size_t max_cell_length = 24;
+    const size_t max_row_length = size * max_cell_length + 8;
+    const size_t rows_per_chunk = std::max<size_t>(1, (size_t(4) << 20) / max_row_length);
+    const size_t chunk_count = (end_row - first_row + rows_per_chunk - 1) / rows_per_chunk;
+    const size_t chunks_per_round = std::max<size_t>(1, thread_count) * 2;
+
+    std::vector<std::unique_ptr<char[]>> buffers(std::min(chunks_per_round, chunk_count));
+    std::vector<size_t> buffer_lengths(buffers.size());
+
+    for (size_t first_chunk = 0; first_chunk < chunk_count; first_chunk += chunks_per_round) {
+        const size_t round_chunk_count = std::min(chunks_per_round, chunk_count - first_chunk);
+        parallel_for(round_chunk_count, thread_count, [&](size_t slot) {
+            if (!buffers[slot]) {
+                buffers[slot].reset(new char[rows_per_chunk * max_row_length]);
+            }
+            char* const buffer = buffers[slot].get();
+            char* position = buffer;
+            std::vector<long> cells(size);
+
+            const size_t row_begin = first_row + (first_chunk + slot) * rows_per_chunk;
+            const size_t row_end = std::min(row_begin + rows_per_chunk, end_row);
+            for (size_t indexFrom = row_begin; indexFrom < row_end; indexFrom++) {
+                row_cells(indexFrom, cells);
+                char* const row_end_bound = position + max_row_length;
+                if (format == MatrixTextFormat::drive) {
+                    position = std::copy_n("D,  ", 4, position);
+                    for (size_t indexTo = 0; indexTo < size; indexTo++) {
+                        if (indexTo != 0) {
+                            *position++ = ',';
+                            *position++ = '\t';
+                        }
+                        position = std::to_chars(position, row_end_bound, cells[indexTo]).ptr;
+                    }
+                    *position++ = ',';
+                }
+                else {
+                    for (size_t indexTo = 0; indexTo <= indexFrom; indexTo++) {
+                        if (indexTo != 0) {
+                            *position++ = ' ';
+                        }
+                        position = std::to_chars(position, row_end_bound, cells[indexTo]).ptr;
+                    }
+                }
+                *position++ = '\n';
+            }
+            buffer_lengths[slot] = position - buffer;
+        });
+
+        for (size_t slot = 0; slot < round_chunk_count; slot++) {
+            outputFile.write(buffers[slot].get(), buffer_lengths[slot]);
+        }
+    }
+}
+
+void write_matrix_text(std::ostream& outputFile, size_t size, MatrixTextFormat format, const MatrixRowCells& row_cells, unsigned thread_count) {
+    write_matrix_rows(outputFile, size, 0, size, format, row_cells, thread_count);
+}
+
+// The lines of the workdrivesymc output (an orienteering problem in TSPLIB format) before the EDGE_WEIGHT_SECTION rows.
+void write_op_header(std::ostream& outputFile, const std::string& outputFilename, const std::string& inputFilename, size_t size, const std::string& worktime_limit_in_minutes) {
+    outputFile << "NAME: " << outputFilename << '\n';
+    outputFile << "COMMENT : based on input from "  << inputFilename << '\n';
+    outputFile << "TYPE : OP" << '\n';
+    outputFile << "DIMENSION : " << size << '\n';
+    outputFile << "COST_LIMIT : " << worktime_limit_in_minutes << '\n';
+    outputFile << "EDGE_WEIGHT_TYPE : EXPLICIT" << '\n';
+    outputFile << "EDGE_WEIGHT_FORMAT : LOWER_DIAG_ROW" << '\n';
+    outputFile << "NODE_COORD_TYPE : NO_COORDS" << '\n';
+    outputFile << "DISPLAY_DATA_TYPE : NO_DISPLAY" << '\n';
+    outputFile << "EDGE_WEIGHT_SECTION" << '\n';
+}
+
+// The lines of the workdrivesymc output after the EDGE_WEIGHT_SECTION rows: the score of every job.
+void write_op_footer(std::ostream& outputFile, const JobColumns& jobs) {
+    outputFile << "NODE_SCORE_SECTION" << '\n';
+    for (size_t i = 0; i < jobs.size(); i++) {
+        outputFile << i + 1 << " " << jobs.score1.at(i) << '\n';
+    }
+
+    outputFile << "EOF" << '\n';
+}
+
+// Jobs and output matrix of an earlier run in drive, workdrive or workdrivesymc mode.
+struct PreviousRun {
+    std::unordered_map<int, size_t> rowOfJobId;
+    std::vector<osrm::util::Coordinate> coordinates;
+    std::vector<double> workDurations;
+    // rows x rows cells for drive and workdrive, the packed lower triangle for workdrivesymc
+    std::vector<long> cells;
+
+    long cell(WorkMode work_mode, size_t indexFrom, size_t indexTo) const {
+        if (work_mode == WorkMode::workdrivesymc) {
+            return cells[indexFrom * (indexFrom + 1) / 2 + indexTo];
+        }
+        return cells[indexFrom * coordinates.size() + indexTo];
+    }
+};
+
+// Appends the integers of one output matrix line, separators (',', spaces, tabs) are skipped.
+void parse_matrix_line(const std::string& line, size_t offset, std::vector<long>& cells) {
+    const char* position = line.c_str() + offset;
+    while (true) {
+        while (*position == ',' || *position == ' ' || *position == '\t' || *position == '\r') {
+            position++;
+        }
+        if (*position == '\0') {
+            return;
+        }
+        char* end;
+        const long cell = std::strtol(position, &end, 10);
+        if (end == position) {
+            throw std::runtime_error("invalid matrix line: " + line);
+        }
+        cells.push_back(cell);
+        position = end;
+    }
+}
+
+PreviousRun read_previous_run(const std::string& previousInputFilename, const std::string& previousOutputFilename, WorkMode work_mode) {
+    PreviousRun previous;
+
+    const MappedFile previousInputFile(previousInputFilename);
+    JobColumns previousJobs;
+    parse_jobs(previousInputFile.data(), previousInputFile.data() + previousInputFile.size(), previousJobs, [](std::string_view) {}, [](std::string_view) {});
+    for (size_t row = 0; row < previousJobs.size(); row++) {
+        previous.rowOfJobId[previousJobs.ids[row]] = row;
+    }
+    previous.coordinates = previousJobs.coordinates();
+    previous.workDurations = previousJobs.score2;
+
+    std::string line;
+
+    std::ifstream previousOutputFile(previousOutputFilename);
+    if (!previousOutputFile.is_open()) {
+        throw std::runtime_error("error opening previous output file " + previousOutputFilename);
+    }
+
+    const size_t size = previous.coordinates.size();
+    if (work_mode == WorkMode::workdrivesymc) {
+        do {
+            if (!std::getline(previousOutputFile, line)) {
+                throw std::runtime_error("no EDGE_WEIGHT_SECTION in previous output file " + previousOutputFilename);
+            }
+        } while (line != "EDGE_WEIGHT_SECTION" && line != "EDGE_WEIGHT_SECTION\r");
+        for (size_t row = 0; row < size && std::getline(previousOutputFile, line); row++) {
+            parse_matrix_line(line, 0, previous.cells);
+        }
+        if (previous.cells.size() != size * (size + 1) / 2) {
+            throw std::runtime_error("previous output file " + previousOutputFilename + " does not hold the LOWER_DIAG_ROW matrix of " + previousInputFilename);
+        }
+    }
+    else {
+        while (std::getline(previousOutputFile, line)) {
+            if (line.compare(0, 2, "D,") == 0) {
+                parse_matrix_line(line, 2, previous.cells);
+            }
+        }
+        if (previous.cells.size() != size * size) {
+            throw std::runtime_error("previous output file " + previousOutputFilename + " does not hold the matrix of " + previousInputFilename);
+        }
+    }
+    return previous;
+}
+
+// Output matrix of a run that knows the input and output of a previous run in the same mode with the same dampening factor.
+// Jobs that kept their id, coordinate and (for workdrive and workdrivesymc) work duration keep their previous cells,
+// only the rows and columns of added or changed jobs are routed.
+struct DeltaMatrix {
+    const PreviousRun* previous = nullptr;
+    WorkMode work_mode = WorkMode::drive;
+    static constexpr size_t no_row = static_cast<size_t>(-1);
+    // row of every job in the previous run, no_row for added or changed jobs
+    std::vector<size_t> previousRow;
+    // position of every added or changed job in changedRows, no_row for the others
+    std::vector<size_t> changedIndex;
+    DurationMatrix changedRowDurations;
+    DurationMatrix changedColumnDurations;
+    // workdrivesymc only reads row -> column with row >= column, so changedColumnDurations starts at this row
+    size_t changedColumnFirstRow = 0;
+    // workdrivesymc keeps only one direction per pair, pairs whose order changed have to be routed again
+    std::vector<size_t> flippedRowIndex;
+    std::vector<size_t> flippedColumnIndex;
+    DurationMatrix flippedDurations;
+
+    bool previous_cell(size_t indexFrom, size_t indexTo, long& cell) const {
+        const size_t previousFrom = previousRow[indexFrom];
+        const size_t previousTo = previousRow[indexTo];
+        if (previousFrom == no_row || previousTo == no_row) {
+            return false;
+        }
+        if (work_mode == WorkMode::workdrivesymc && previousFrom < previousTo) {
+            return false;
+        }
+        cell = previous->cell(work_mode, previousFrom, previousTo);
+        return true;
+    }
+
+    double seconds(size_t indexFrom, size_t indexTo) const {
+        if (changedIndex[indexFrom] != no_row) {
+            return changedRowDurations.at(changedIndex[indexFrom], indexTo);
+        }
+        if (changedIndex[indexTo] != no_row) {
+            return changedColumnDurations.at(indexFrom - changedColumnFirstRow, changedIndex[indexTo]);
+        }
+        return flippedDurations.at(flippedRowIndex[indexFrom], flippedColumnIndex[indexTo]);
+    }
+};
+
+DeltaMatrix build_delta_matrix(const PreviousRun& previous, WorkMode work_mode, const std::vector<osrm::util::Coordinate>& coordinates,
+    const std::vector<int>& jobRowToId, const std::vector<double>& workDurations, const RoutingBackend& backend, size_t tile_size, unsigned thread_count,
+    SnappingHints* hints = nullptr) {
+    DeltaMatrix delta;
+    delta.previous = &previous;
+    delta.work_mode = work_mode;
+
+    const size_t size = coordinates.size();
+    std::vector<size_t> changedRows;
+    delta.changedIndex.assign(size, DeltaMatrix::no_row);
+    for (size_t row = 0; row < size; row++) {
+        size_t previousRow = DeltaMatrix::no_row;
+        const auto previousJob = previous.rowOfJobId.find(jobRowToId[row]);
+        if (previousJob != previous.rowOfJobId.end()) {
+            const auto& previousCoordinate = previous.coordinates[previousJob->second];
+            const bool same_coordinate = previousCoordinate == coordinates[row];
+            const bool same_work = work_mode == WorkMode::drive || previous.workDurations[previousJob->second] == workDurations[row];
+            if (same_coordinate && same_work) {
+                previousRow = previousJob->second;
+            }
+        }
+        delta.previousRow.push_back(previousRow);
+        if (previousRow == DeltaMatrix::no_row) {
+            delta.changedIndex[row] = changedRows.size();
+            changedRows.push_back(row);
+        }
+    }
+
+    std::vector<size_t> flippedRows;
+    std::vector<size_t> flippedColumns;
+    delta.flippedRowIndex.assign(size, DeltaMatrix::no_row);
+    delta.flippedColumnIndex.assign(size, DeltaMatrix::no_row);
+    if (work_mode == WorkMode::workdrivesymc) {
+        for (size_t indexFrom = 0; indexFrom < size; indexFrom++) {
+            for (size_t indexTo = 0; indexTo < indexFrom; indexTo++) {
+                const size_t previousFrom = delta.previousRow[indexFrom];
+                const size_t previousTo = delta.previousRow[indexTo];
+                if (previousFrom == DeltaMatrix::no_row || previousTo == DeltaMatrix::no_row || previousFrom > previousTo) {
+                    continue;
+                }
+                if (delta.flippedRowIndex[indexFrom] == DeltaMatrix::no_row) {
+                    delta.flippedRowIndex[indexFrom] = flippedRows.size();
+                    flippedRows.push_back(indexFrom);
+                }
+                if (delta.flippedColumnIndex[indexTo] == DeltaMatrix::no_row) {
+                    delta.flippedColumnIndex[indexTo] = flippedColumns.size();
+                    flippedColumns.push_back(indexTo);
+                }
+            }
+        }
+    }
+
+    if (!changedRows.empty()) {
+        // for workdrivesymc only the lower triangle rectangles: the changed rows towards the columns up to the last of them,
+        // and the rows after the first of them towards the changed columns
+        const bool lower = work_mode == WorkMode::workdrivesymc;
+        std::vector<size_t> rowDestinations(lower ? changedRows.back() + 1 : size);
+        std::iota(rowDestinations.begin(), rowDestinations.end(), 0);
+        delta.changedColumnFirstRow = lower ? changedRows.front() + 1 : 0;
+        std::vector<size_t> columnSources(size - delta.changedColumnFirstRow);
+        std::iota(columnSources.begin(), columnSources.end(), delta.changedColumnFirstRow);
+        delta.changedRowDurations = query_table_durations(backend, coordinates, changedRows, rowDestinations, tile_size, thread_count, hints);
+        if (!columnSources.empty()) {
+            delta.changedColumnDurations = query_table_durations(backend, coordinates, columnSources, changedRows, tile_size, thread_count, hints);
+        }
+    }
+    if (!flippedRows.empty()) {
+        delta.flippedDurations = query_table_durations(backend, coordinates, flippedRows, flippedColumns, tile_size, thread_count, hints);
+    }
+
+    std::cout << "delta: " << changedRows.size() << " of " << size << " jobs added or changed, "
+        << flippedRows.size() << " rows with reordered pairs routed again" << '\n';
+    return delta;
+}
+
+// Binary companion of a matrix output file, written next to it as OUTPUT.matrix.bin with --binary-matrix.
+// Layout (native byte order): BinaryMatrixHeader, dimension int32 job ids in row order,
+// then the float durations in seconds as routed, before dampening and work time,
+// either dimension x dimension row-major or the lower triangle with diagonal row by row.
+const char binary_matrix_magic[8] = { 'T', 'A', 'B', 'L', 'E', 'M', 'T', 'X' };
+const std::uint32_t binary_matrix_version = 1;
+
+enum class MatrixLayout : std::uint32_t {
+    full = 0,
+    lower_triangle = 1
+};
+
+struct BinaryMatrixHeader {
+    char magic[8];
+    std::uint32_t version;
+    MatrixLayout layout;
+    std::uint64_t dimension;
+    double dampeningFactor;
+};
+
+std::string binary_matrix_filename(const std::string& outputFilename) {
+    return outputFilename + ".matrix.bin";
+}
+
+void write_binary_matrix_header(std::ostream& matrixFile, MatrixLayout layout, double dampeningFactor, const std::vector<int>& jobRowToId) {
+    BinaryMatrixHeader header;
+    std::copy(std::begin(binary_matrix_magic), std::end(binary_matrix_magic), header.magic);
+    header.version = binary_matrix_version;
+    header.layout = layout;
+    header.dimension = jobRowToId.size();
+    header.dampeningFactor = dampeningFactor;
+    matrixFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    const std::vector<std::int32_t> jobIds(jobRowToId.begin(), jobRowToId.end());
+    matrixFile.write(reinterpret_cast<const char*>(jobIds.data()), jobIds.size() * sizeof(std::int32_t));
+}
+
+// matrixRowOf maps the job rows to the rows and columns of a deduplicated durations_matrix, empty if they are the same.
+void write_binary_matrix(const std::string& filename, MatrixLayout layout, double dampeningFactor, const std::vector<int>& jobRowToId, const DurationMatrix& durations_matrix,
+    const std::vector<size_t>& matrixRowOf) {
+    std::ofstream matrixFile(filename, std::ios::binary);
+    if (!matrixFile.is_open()) {
+        throw std::runtime_error("error writing binary matrix file " + filename);
+    }
+
+    write_binary_matrix_header(matrixFile, layout, dampeningFactor, jobRowToId);
+
+    std::vector<float> expanded;
+    for (size_t row = 0; row < jobRowToId.size(); row++) {
+        const size_t count = layout == MatrixLayout::lower_triangle ? row + 1 : jobRowToId.size();
+        if (matrixRowOf.empty()) {
+            matrixFile.write(reinterpret_cast<const char*>(durations_matrix.row(row)), count * sizeof(float));
+            continue;
+        }
+        expanded.resize(count);
+        for (size_t column = 0; column < count; column++) {
+            expanded[column] = durations_matrix.value(matrixRowOf[row], matrixRowOf[column]);
+        }
+        matrixFile.write(reinterpret_cast<const char*>(expanded.data()), count * sizeof(float));
+    }
+    if (!matrixFile) {
+        throw std::runtime_error("error writing binary matrix file " + filename);
+    }
+}
+
+// --band-rows: progress of a banded run, stored in OUTPUT.checkpoint after every band as
+// "CHECKPOINT <run fingerprint> <band rows> <next row> <output bytes> <binary matrix bytes>".
+// The output files hold exactly the rows before next_row at these sizes, anything a killed run wrote after them is cut off.
+struct BandCheckpoint {
+    std::string fingerprint;
+    size_t band_rows = 0;
+    size_t next_row = 0;
+    std::uint64_t output_bytes = 0;
+    std::uint64_t binary_bytes = 0;
+
+    bool read(const std::string& filename) {
+        std::ifstream file(filename);
+        std::string tag;
+        return static_cast<bool>(file >> tag >> fingerprint >> band_rows >> next_row >> output_bytes >> binary_bytes) && tag == "CHECKPOINT";
+    }
+
+    // written to a temporary file and renamed, so the checkpoint is never half written
+    void write(const std::string& filename) const {
+        const std::string temporaryFilename = filename + ".tmp";
+        {
+            std::ofstream file(temporaryFilename, std::ios::trunc);
+            file << "CHECKPOINT " << fingerprint << ' ' << band_rows << ' ' << next_row << ' ' << output_bytes << ' ' << binary_bytes << '\n';
+            if (!file.flush()) {
+                throw std::runtime_error("error writing checkpoint file " + temporaryFilename);
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryFilename, filename, error);
+        if (error) {
+            throw std::runtime_error("error replacing checkpoint file " + filename + ": " + error.message());
+        }
+    }
+};
+
+std::string checkpoint_filename(const std::string& outputFilename) {
+    return outputFilename + ".checkpoint";
+}
+
+// A checkpoint only resumes the same run: same input bytes, mode arguments and options (apart from --threads, --stats and
+// --hints-cache, which do not change the output).
+std::string band_run_fingerprint(const char* input, size_t input_size, int argc, const char* argv[], const CommandLineOptions& options) {
+    std::uint64_t hash = std::hash<std::string_view>()(std::string_view(input, input_size));
+    for (int i = 3; i < argc; i++) {
+        hash = hash * 1099511628211ull ^ std::hash<std::string>()(argv[i]);
+    }
+    const std::map<std::string, std::string> sortedOptions(options.begin(), options.end());
+    for (const auto& option : sortedOptions) {
+        if (option.first != "threads" && option.first != "stats" && option.first != "hints-cache") {
+            hash = hash * 1099511628211ull ^ std::hash<std::string>()(option.first + "=" + option.second);
+        }
+    }
+    std::ostringstream fingerprint;
+    fingerprint << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return fingerprint.str();
+}
+
+// Settings the cells of a drive, workdrive or workdrivesymc output were computed with, stored next to it in OUTPUT.run as
+// "RUN <mode> <dampening factor> <dedup tolerance> <symmetrisation>". --previous-output only reuses cells of the same settings.
+struct RunSettings {
+    std::string mode;
+    double dampeningFactor = 1.0;
+    double dedupTolerance = 0.0;
+    std::string symmetrisation = "none";
+
+    bool read(const std::string& filename) {
+        std::ifstream file(filename);
+        std::string tag;
+        return static_cast<bool>(file >> tag >> mode >> dampeningFactor >> dedupTolerance >> symmetrisation) && tag == "RUN";
+    }
+
+    // the numbers in their shortest form that reads back to the same double
+    void write(const std::string& filename) const {
+        char dampening[32];
+        char tolerance[32];
+        *std::to_chars(dampening, dampening + sizeof(dampening) - 1, dampeningFactor).ptr = '\0';
+        *std::to_chars(tolerance, tolerance + sizeof(tolerance) - 1, dedupTolerance).ptr = '\0';
+        std::ofstream file(filename, std::ios::trunc);
+        file << "RUN " << mode << ' ' << dampening << ' ' << tolerance << ' ' << symmetrisation << '\n';
+        if (!file.flush()) {
+            throw std::runtime_error("error writing run settings file " + filename);
+        }
+    }
+
+    bool operator==(const RunSettings& other) const {
+        return mode == other.mode && dampeningFactor == other.dampeningFactor && dedupTolerance == other.dedupTolerance && symmetrisation == other.symmetrisation;
+    }
+
+    std::string describe() const {
+        std::ostringstream text;
+        text << "mode " << mode << ", dampening factor " << dampeningFactor << ", dedup tolerance " << dedupTolerance << ", symmetrise " << symmetrisation;
+        return text.str();
+    }
+};
+
+std::string run_settings_filename(const std::string& outputFilename) {
+    return outputFilename + ".run";
+}
+
+bool is_binary_matrix_file(const std::string& filename) {
+    std::ifstream matrixFile(filename, std::ios::binary);
+    char magic[sizeof(binary_matrix_magic)] = {};
+    matrixFile.read(magic, sizeof(magic));
+    return matrixFile && std::equal(std::begin(magic), std::end(magic), std::begin(binary_matrix_magic));
+}
+
+// View into a mapped binary matrix file.
+struct BinaryMatrix {
+    const BinaryMatrixHeader* header = nullptr;
+    const std::int32_t* jobIds = nullptr;
+    const float* durations = nullptr;
+
+    // Routed seconds from row to row. The lower triangle layout holds only one direction per pair, like LOWER_DIAG_ROW.
+    double seconds(size_t indexFrom, size_t indexTo) const {
+        if (header->layout == MatrixLayout::lower_triangle) {
+            if (indexFrom < indexTo) {
+                std::swap(indexFrom, indexTo);
+            }
+            return DurationMatrix::seconds(durations[indexFrom * (indexFrom + 1) / 2 + indexTo]);
+        }
+        return DurationMatrix::seconds(durations[indexFrom * header->dimension + indexTo]);
+    }
+};
+
+// Validates the mapped file against the job list of the INPUT file, the rows have to be the same jobs in the same order.
+BinaryMatrix open_binary_matrix(const MappedFile& matrixFile, const std::vector<int>& jobRowToId, const std::string& filename) {
+    BinaryMatrix matrix;
+    if (matrixFile.size() < sizeof(BinaryMatrixHeader)) {
+        throw std::runtime_error("binary matrix file " + filename + " is too short");
+    }
+    matrix.header = reinterpret_cast<const BinaryMatrixHeader*>(matrixFile.data());
+    if (!std::equal(std::begin(binary_matrix_magic), std::end(binary_matrix_magic), matrix.header->magic) || matrix.header->version != binary_matrix_version) {
+        throw std::runtime_error("unsupported binary matrix file " + filename);
+    }
+
+    const size_t dimension = static_cast<size_t>(matrix.header->dimension);
+    const size_t cell_count = matrix.header->layout == MatrixLayout::lower_triangle ? dimension * (dimension + 1) / 2 : dimension * dimension;
+    if (matrixFile.size() != sizeof(BinaryMatrixHeader) + dimension * sizeof(std::int32_t) + cell_count * sizeof(float)) {
+        throw std::runtime_error("binary matrix file " + filename + " has an unexpected size");
+    }
+    matrix.jobIds = reinterpret_cast<const std::int32_t*>(matrixFile.data() + sizeof(BinaryMatrixHeader));
+    matrix.durations = reinterpret_cast<const float*>(matrix.jobIds + dimension);
+
+    if (dimension != jobRowToId.size() || !std::equal(jobRowToId.begin(), jobRowToId.end(), matrix.jobIds)) {
+        throw std::runtime_error("binary matrix file " + filename + " was computed for a different job list");
+    }
+    return matrix;
+}
+
+// Uniform grid over the job coordinates for nearest neighbour queries. Distances are equirectangular, which is
+// precise enough to pick routing candidates and needs no trigonometry per pair.
+class GridIndex {
+public:
+    GridIndex(const JobColumns& jobs, size_t points_per_cell) : x_(jobs.size()), y_(jobs.size()) {
+        if (jobs.size() == 0) {
+            return;
+        }
+        const auto latitudes = std::minmax_element(jobs.latitudes.begin(), jobs.latitudes.end());
+        const double longitude_scale = std::cos((*latitudes.first + *latitudes.second) / 2.0 * 3.14159265358979323846 / 180.0);
+        for (size_t row = 0; row < jobs.size(); row++) {
+            x_[row] = jobs.longitudes[row] * longitude_scale;
+            y_[row] = jobs.latitudes[row];
+        }
+        min_x_ = *std::min_element(x_.begin(), x_.end());
+        min_y_ = *std::min_element(y_.begin(), y_.end());
+        const double width = *std::max_element(x_.begin(), x_.end()) - min_x_;
+        const double height = *std::max_element(y_.begin(), y_.end()) - min_y_;
+        const double cells_wanted = std::max(1.0, static_cast<double>(jobs.size()) / std::max<size_t>(points_per_cell, 1));
+        cell_size_ = std::max({ std::sqrt(width * height / cells_wanted), std::max(width, height) / cells_wanted, 1e-9 });
+        columns_ = static_cast<size_t>(width / cell_size_) + 1;
+        rows_ = static_cast<size_t>(height / cell_size_) + 1;
+
+        cells_.resize(columns_ * rows_);
+        for (size_t row = 0; row < jobs.size(); row++) {
+            cells_[cell_of(row)].push_back(row);
+        }
+    }
+
+    size_t cell_count() const {
+        return cells_.size();
+    }
+
+    const std::vector<size_t>& cell_rows(size_t cell) const {
+        return cells_[cell];
+    }
+
+    // Rows of the k jobs nearest to row, without row itself, nearest first. Rings of cells around the cell of row
+    // are searched until no unvisited cell can hold a nearer job than the k-th found.
+    std::vector<size_t> nearest(size_t row, size_t k) const {
+        std::priority_queue<std::pair<double, size_t> > best;
+        const size_t cell = cell_of(row);
+        const long cell_x = static_cast<long>(cell % columns_);
+        const long cell_y = static_cast<long>(cell / columns_);
+        const long max_ring = static_cast<long>(std::max(columns_, rows_));
+        for (long ring = 0; ring <= max_ring; ring++) {
+            if (best.size() == k && (ring - 1) * cell_size_ >= std::sqrt(best.top().first)) {
+                break;
+            }
+            for (long y = cell_y - ring; y <= cell_y + ring; y++) {
+                if (y < 0 || y >= static_cast<long>(rows_)) {
+                    continue;
+                }
+                const bool full_row = y == cell_y - ring || y == cell_y + ring;
+                for (long x = cell_x - ring; x <= cell_x + ring; x += full_row ? 1 : 2 * std::max(ring, 1L)) {
+                    if (x < 0 || x >= static_cast<long>(columns_)) {
+                        continue;
+                    }
+                    for (const size_t candidate : cells_[y * columns_ + x]) {
+                        if (candidate == row) {
+                            continue;
+                        }
+                        const double dx = x_[candidate] - x_[row];
+                        const double dy = y_[candidate] - y_[row];
+                        best.emplace(dx * dx + dy * dy, candidate);
+                        if (best.size() > k) {
+                            best.pop();
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<size_t> rows(best.size());
+        for (size_t i = rows.size(); i > 0; i--) {
+            rows[i - 1] = best.top().second;
+            best.pop();
+        }
+        return rows;
+    }
+
+private:
+    size_t cell_of(size_t row) const {
+        const size_t column = std::min(static_cast<size_t>((x_[row] - min_x_) / cell_size_), columns_ - 1);
+        const size_t line = std::min(static_cast<size_t>((y_[row] - min_y_) / cell_size_), rows_ - 1);
+        return line * columns_ + column;
+    }
+
+    std::vector<double> x_;
+    std::vector<double> y_;
+    double min_x_ = 0;
+    double min_y_ = 0;
+    double cell_size_ = 1;
+    size_t columns_ = 1;
+    size_t rows_ = 1;
+    std::vector<std::vector<size_t> > cells_;
+};
+
+// Routed durations of selected pairs only, rows in compressed sparse row form with the columns of each row sorted.
+struct SparseMatrix {
+    double dampeningFactor = 1.0;
+    std::vector<size_t> rowBegin;
+    std::vector<std::uint32_t> columns;
+    std::vector<float> durations;
+
+    size_t rows() const {
+        return rowBegin.empty() ? 0 : rowBegin.size() - 1;
+    }
+
+    // Routed seconds from row to row. A pair that was only routed in the other direction uses that direction,
+    // false if neither direction is in the matrix.
+    bool seconds(size_t indexFrom, size_t indexTo, double& seconds) const {
+        if (indexFrom == indexTo) {
+            seconds = 0;
+            return true;
+        }
+        for (int direction = 0; direction < 2; direction++) {
+            const auto begin = columns.begin() + rowBegin[indexFrom];
+            const auto end = columns.begin() + rowBegin[indexFrom + 1];
+            const auto column = std::lower_bound(begin, end, static_cast<std::uint32_t>(indexTo));
+            if (column != end && *column == indexTo) {
+                seconds = DurationMatrix::seconds(durations[column - columns.begin()]);
+                return true;
+            }
+            std::swap(indexFrom, indexTo);
+        }
+        return false;
+    }
+};
+
+// sparse mode: routes every job to its neighbours nearest jobs and to the home depots (job ids 0 and 1).
+// The sources are batched by grid cell, one query per cell carries the cell's jobs and the union of their candidates,
+// so routing and memory grow with jobs x neighbours instead of jobs x jobs.
+SparseMatrix query_sparse_durations(const RoutingBackend& backend, const JobColumns& jobs, const std::vector<osrm::util::Coordinate>& coordinates,
+    size_t neighbours, unsigned thread_count, SnappingHints* hints = nullptr) {
+    std::vector<size_t> depotRows;
+    for (size_t row = 0; row < jobs.size(); row++) {
+        if (jobs.ids[row] == 0 || jobs.ids[row] == 1) {
+            depotRows.push_back(row);
+        }
+    }
+
+    const GridIndex index(jobs, std::max<size_t>(neighbours, 16));
+    std::vector<std::vector<std::pair<std::uint32_t, float> > > rowEdges(jobs.size());
+    parallel_for(index.cell_count(), thread_count, [&](size_t cell) {
+        const std::vector<size_t>& sources = index.cell_rows(cell);
+        if (sources.empty()) {
+            return;
+        }
+        std::vector<std::vector<size_t> > candidates(sources.size());
+        std::vector<size_t> destinations;
+        for (size_t i = 0; i < sources.size(); i++) {
+            candidates[i] = index.nearest(sources[i], neighbours);
+            for (const size_t depot : depotRows) {
+                if (depot != sources[i]) {
+                    candidates[i].push_back(depot);
+                }
+            }
+            std::sort(candidates[i].begin(), candidates[i].end());
+            candidates[i].erase(std::unique(candidates[i].begin(), candidates[i].end()), candidates[i].end());
+            destinations.insert(destinations.end(), candidates[i].begin(), candidates[i].end());
+        }
+        std::sort(destinations.begin(), destinations.end());
+        destinations.erase(std::unique(destinations.begin(), destinations.end()), destinations.end());
+        if (destinations.empty()) {
+            return;
+        }
+
+        const DurationMatrix cell_durations = query_table_durations(backend, coordinates, sources, destinations, 0, 1, hints);
+        for (size_t i = 0; i < sources.size(); i++) {
+            auto& edges = rowEdges[sources[i]];
+            for (const size_t candidate : candidates[i]) {
+                const size_t column = std::lower_bound(destinations.begin(), destinations.end(), candidate) - destinations.begin();
+                edges.emplace_back(static_cast<std::uint32_t>(candidate), cell_durations.row(i)[column]);
+            }
+        }
+    });
+
+    SparseMatrix sparse;
+    sparse.rowBegin.push_back(0);
+    for (const auto& edges : rowEdges) {
+        for (const auto& edge : edges) {
+            sparse.columns.push_back(edge.first);
+            sparse.durations.push_back(edge.second);
+        }
+        sparse.rowBegin.push_back(sparse.columns.size());
+    }
+    return sparse;
+}
+
+// Sparse edge list: a TSPLIB like header, then one "FROM-ID TO-ID SECONDS" line per routed pair.
+const char* const sparse_matrix_type_line = "TYPE : SPARSE_EDGES";
+
+void write_sparse_matrix(std::ostream& out, const std::string& name, const std::string& inputFilename, size_t neighbours,
+    const std::vector<int>& jobRowToId, const SparseMatrix& sparse) {
+    out << sparse_matrix_type_line << '\n';
+    out << "NAME: " << name << '\n';
+    out << "COMMENT : based on input from " << inputFilename << '\n';
+    out << "DIMENSION : " << jobRowToId.size() << '\n';
+    out << "NEIGHBOURS : " << neighbours << '\n';
+    out << "DAMPENING_FACTOR : " << sparse.dampeningFactor << '\n';
+    out << "EDGES : " << sparse.columns.size() << '\n';
+    out << "EDGE_SECTION" << '\n';
+    out << std::fixed << std::setprecision(1);
+    for (size_t row = 0; row < sparse.rows(); row++) {
+        for (size_t edge = sparse.rowBegin[row]; edge < sparse.rowBegin[row + 1]; edge++) {
+            out << jobRowToId[row] << ' ' << jobRowToId[sparse.columns[edge]] << ' ' << DurationMatrix::seconds(sparse.durations[edge]) << '\n';
+        }
+    }
+    out << "EOF" << '\n';
+}
+
+bool is_sparse_matrix_file(const std::string& filename) {
+    std::ifstream matrixFile(filename);
+    std::string line;
+    std::getline(matrixFile, line);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return line == sparse_matrix_type_line;
+}
+
+// Reads a sparse edge list written for the jobs of INPUT, job ids are mapped to the rows of jobRowToId.
+SparseMatrix read_sparse_matrix(const std::string& filename, const std::vector<int>& jobRowToId) {
+    std::ifstream matrixFile(filename);
+    if (!matrixFile.is_open()) {
+        throw std::runtime_error("error opening sparse matrix file " + filename);
+    }
+    std::unordered_map<int, size_t> rowOfJobId;
+    for (size_t row = 0; row < jobRowToId.size(); row++) {
+        rowOfJobId[jobRowToId[row]] = row;
+    }
+
+    SparseMatrix sparse;
+    std::string line;
+    bool in_edges = false;
+    std::vector<std::pair<std::pair<size_t, size_t>, float> > edges;
+    while (std::getline(matrixFile, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!in_edges) {
+            if (line.compare(0, 19, "DAMPENING_FACTOR : ") == 0) {
+                sparse.dampeningFactor = std::stod(line.substr(19));
+            }
+            else if (line.compare(0, 12, "DIMENSION : ") == 0 && std::stoul(line.substr(12)) != jobRowToId.size()) {
+                throw std::runtime_error("sparse matrix file " + filename + " has a different dimension than the input");
+            }
+            in_edges = line == "EDGE_SECTION";
+            continue;
+        }
+        if (line == "EOF") {
+            break;
+        }
+        const char* end = line.c_str() + line.size();
+        int fromId = 0;
+        int toId = 0;
+        double seconds = 0;
+        const char* position = parse_field(line.c_str(), end, fromId);
+        position = position == nullptr ? nullptr : parse_field(position, end, toId);
+        position = position == nullptr ? nullptr : parse_field(position, end, seconds);
+        if (position == nullptr) {
+            throw std::runtime_error("invalid sparse matrix line: " + line);
+        }
+        const auto from = rowOfJobId.find(fromId);
+        const auto to = rowOfJobId.find(toId);
+        if (from == rowOfJobId.end() || to == rowOfJobId.end()) {
+            throw std::runtime_error("sparse matrix file " + filename + " holds jobs that are not in the input: " + line);
+        }
+        edges.push_back({ { from->second, to->second }, static_cast<float>(seconds) });
+    }
+    if (!in_edges) {
+        throw std::runtime_error("no EDGE_SECTION in sparse matrix file " + filename);
+    }
+
+    std::sort(edges.begin(), edges.end());
+    sparse.rowBegin.assign(jobRowToId.size() + 1, 0);
+    for (const auto& edge : edges) {
+        sparse.rowBegin[edge.first.first + 1]++;
+        sparse.columns.push_back(static_cast<std::uint32_t>(edge.first.second));
+        sparse.durations.push_back(edge.second);
+    }
+    std::partial_sum(sparse.rowBegin.begin(), sparse.rowBegin.end(), sparse.rowBegin.begin());
+    return sparse;
+}
+
+// resultsymc --geojson: writes every job as a Point and every leg of the tour as a routed LineString.
+// The legs are routed window by window on thread_count threads and written in tour order as soon as a
+// window is complete, so memory stays bounded by one window however long the tour is.
+void write_tour_geojson(std::ostream& out, const RoutingBackend& backend, const JobColumns& jobs,
+    const std::vector<osrm::util::Coordinate>& coordinates, const std::vector<size_t>& tourRows,
+    const std::vector<bool>& isSelected, unsigned thread_count) {
+    out << std::setprecision(10);
+    out << "{\"type\":\"FeatureCollection\",\"features\":[\n";
+
+    for (size_t row = 0; row < jobs.size(); row++) {
+        const int job_id = jobs.ids[row];
+        const char* type = job_id == 0 || job_id == 1 ? "home" : isSelected[row] ? "active" : "inactive";
+        if (row != 0) {
+            out << ",\n";
+        }
+        out << "{\"type\":\"Feature\",\"geometry\":{\"type\":\"Point\",\"coordinates\":["
+            << jobs.longitudes[row] << "," << jobs.latitudes[row] << "]},\"properties\":{\"id\":" << job_id
+            << ",\"type\":\"" << type << "\",\"score1\":" << jobs.score1[row] << ",\"score2\":" << jobs.score2[row] << "}}";
+    }
+
+    const size_t leg_count = tourRows.size() < 2 ? 0 : tourRows.size() - 1;
+    const size_t window_size = std::max<size_t>(1, thread_count) * 16;
+    std::vector<RoutedLeg> window(window_size);
+    for (size_t window_begin = 0; window_begin < leg_count; window_begin += window_size) {
+        const size_t window_legs = std::min(window_size, leg_count - window_begin);
+        parallel_for(window_legs, thread_count, [&](size_t i) {
+            const size_t leg = window_begin + i;
+            window[i] = backend.route(coordinates[tourRows[leg]], coordinates[tourRows[leg + 1]]);
+        });
+
+        for (size_t i = 0; i < window_legs; i++) {
+            const size_t leg = window_begin + i;
+            out << ",\n{\"type\":\"Feature\",\"geometry\":{\"type\":\"LineString\",\"coordinates\":[";
+            for (size_t point = 0; point < window[i].points.size(); point++) {
+                out << (point == 0 ? "[" : ",[") << window[i].points[point].first << "," << window[i].points[point].second << "]";
+            }
+            out << "]},\"properties\":{\"leg\":" << leg << ",\"from\":" << jobs.ids[tourRows[leg]]
+                << ",\"to\":" << jobs.ids[tourRows[leg + 1]] << ",\"seconds\":" << window[i].seconds << "}}";
+            window[i] = RoutedLeg();
+        }
+    }
+    out << "\n]}\n";
+}
+
+// Sums of a tour as the resultsymc report prints them.
+struct TourTotals {
+    double score1Sum = 0;
+    double workDurationSum = 0;
+    double dampedDrivingMinutes = 0;
+    double totalHours = 0;
+};
+
+// Writes the resultsymc report lines that follow the stop list: the score1 and work duration sums of totals, the damped
+// driving minutes and total hours (filled into totals) and one "id;driving-minutes;work-duration;" line per stop.
+template <typename DrivingMinutes>
+void write_tour_report(std::ostream& out, const JobColumns& jobs, const std::vector<size_t>& tourRows, TourTotals& totals, DrivingMinutes dampedDrivingMinutes) {
+    out << totals.score1Sum << '\n';
+    out << totals.workDurationSum << '\n';
+
+    totals.dampedDrivingMinutes = 0;
+    for (size_t i = 1; i < tourRows.size(); i++) {
+        totals.dampedDrivingMinutes += dampedDrivingMinutes(tourRows[i - 1], tourRows[i]);
+    }
+
+    out << std::lround(totals.dampedDrivingMinutes) << '\n';
+
+    totals.totalHours = (totals.workDurationSum + totals.dampedDrivingMinutes)/60.0;
+    out << std::fixed << std::setprecision(1) << totals.totalHours << std::setprecision(0) << '\n';
+
+    for (size_t i = 0; i < tourRows.size(); i++) {
+        int drivingTimeFromPreviousJob = 0;
+        if (i != 0) {
+            drivingTimeFromPreviousJob = std::lround(dampedDrivingMinutes(tourRows[i - 1], tourRows[i]));
+        }
+        out << jobs.ids.at(tourRows[i]) << ";" << drivingTimeFromPreviousJob << ";" << jobs.score2.at(tourRows[i]) << ";" << "\n";
+    }
+}
+
+// solve mode: the workdrivesymc cells (damped driving minutes plus half the work duration of both ends) as a packed lower triangle.
+struct SymmetricCosts {
+    std::vector<std::int32_t> cells;
+
+    long operator()(size_t a, size_t b) const {
+        if (a < b) {
+            std::swap(a, b);
+        }
+        return cells[a * (a + 1) / 2 + b];
+    }
+};
+
+// A path from the start row to the end row, score is the score1 sum of its rows and cost the sum of its cells.
+struct OrienteeringTour {
+    std::vector<size_t> rows;
+    double score = 0;
+    long cost = 0;
+};
+
+// --starts default: a fixed number, so that the same command finds the same tour on every machine
+const size_t default_solver_starts = 16;
+
+// Multi-start iterated local search for the orienteering problem workdrivesymc describes: collect as much score1 as
+// possible on a path from start_row to end_row whose cost stays within cost_limit (COST_LIMIT).
+// Every start builds a tour by (for starts > 0 randomised) best ratio insertion and improves it by 2-opt, then
+// repeatedly removes a random stretch of stops, 2-opts and inserts again, keeping the result when it scores better.
+// Starts run in parallel and are seeded by their index, so the result does not depend on the thread count.
+class OrienteeringSolver {
+public:
+    OrienteeringSolver(const SymmetricCosts& costs, const std::vector<double>& scores, size_t start_row, size_t end_row, long cost_limit)
+        : costs_(costs), scores_(scores), start_row_(start_row), end_row_(end_row), cost_limit_(cost_limit) {
+    }
+
+    OrienteeringTour solve(size_t starts, size_t iterations, unsigned thread_count) const {
+        std::vector<OrienteeringTour> tours(std::max<size_t>(starts, 1));
+        parallel_for(tours.size(), thread_count, [&](size_t start) {
+            tours[start] = run_start(start, iterations);
+        });
+        size_t best = 0;
+        for (size_t start = 1; start < tours.size(); start++) {
+            if (better(tours[start], tours[best])) {
+                best = start;
+            }
+        }
+        return tours[best];
+    }
+
+private:
+    static bool better(const OrienteeringTour& a, const OrienteeringTour& b) {
+        if (std::abs(a.score - b.score) > 1e-9) {
+            return a.score > b.score;
+        }
+        return a.cost < b.cost;
+    }
+
+    void update_totals(OrienteeringTour& tour) const {
+        tour.score = 0;
+        tour.cost = 0;
+        for (size_t i = 0; i < tour.rows.size(); i++) {
+            tour.score += scores_[tour.rows[i]];
+            if (i != 0) {
+                tour.cost += costs_(tour.rows[i - 1], tour.rows[i]);
+            }
+        }
+    }
+
+    // Inserts unvisited rows while one fits into the cost limit, each time the row with the best score per added cost
+    // at its cheapest position, or a random one of the candidate_list best. The cheapest position of every row is
+    // kept up to date incrementally: an insertion only replaces one edge of the path by two.
+    void insert_greedy(OrienteeringTour& tour, std::vector<char>& visited, std::mt19937& random, size_t candidate_list) const {
+        struct Insertion {
+            double ratio;
+            size_t row;
+        };
+        auto more_attractive = [](const Insertion& a, const Insertion& b) {
+            return a.ratio > b.ratio || (a.ratio == b.ratio && a.row < b.row);
+        };
+
+        // cheapest insertion of every row as the added cost and the row after which it goes
+        std::vector<long> best_delta(scores_.size(), 0);
+        std::vector<size_t> best_before(scores_.size(), 0);
+        std::vector<size_t> candidate_rows;
+        // cost of the edge ending at each position of the path, refreshed before every full search
+        std::vector<long> edge_costs;
+        auto update_edge_costs = [&]() {
+            edge_costs.resize(tour.rows.size());
+            for (size_t position = 1; position < tour.rows.size(); position++) {
+                edge_costs[position] = costs_(tour.rows[position - 1], tour.rows[position]);
+            }
+        };
+        auto find_cheapest = [&](size_t row) {
+            long cost_from_before = costs_(tour.rows[0], row);
+            for (size_t position = 1; position < tour.rows.size(); position++) {
+                const long cost_to_after = costs_(row, tour.rows[position]);
+                const long delta = cost_from_before + cost_to_after - edge_costs[position];
+                if (position == 1 || delta < best_delta[row]) {
+                    best_delta[row] = delta;
+                    best_before[row] = tour.rows[position - 1];
+                }
+                cost_from_before = cost_to_after;
+            }
+        };
+        update_edge_costs();
+        for (size_t row = 0; row < scores_.size(); row++) {
+            if (!visited[row] && scores_[row] > 0) {
+                candidate_rows.push_back(row);
+                find_cheapest(row);
+            }
+        }
+
+        std::vector<Insertion> candidates;
+        while (true) {
+            candidates.clear();
+            for (const size_t row : candidate_rows) {
+                if (visited[row] || tour.cost + best_delta[row] > cost_limit_) {
+                    continue;
+                }
+                candidates.push_back({ scores_[row] / (std::max<long>(best_delta[row], 0) + 1), row });
+                std::push_heap(candidates.begin(), candidates.end(), more_attractive);
+                if (candidates.size() > candidate_list) {
+                    std::pop_heap(candidates.begin(), candidates.end(), more_attractive);
+                    candidates.pop_back();
+                }
+            }
+            if (candidates.empty()) {
+                return;
+            }
+            std::sort(candidates.begin(), candidates.end(), more_attractive);
+            const size_t chosen = candidates[candidate_list > 1 ? random() % candidates.size() : 0].row;
+
+            const size_t before = best_before[chosen];
+            const auto position = std::find(tour.rows.begin(), tour.rows.end(), before) + 1;
+            const size_t after = *position;
+            tour.rows.insert(position, chosen);
+            tour.cost += best_delta[chosen];
+            tour.score += scores_[chosen];
+            visited[chosen] = 1;
+
+            update_edge_costs();
+            for (const size_t row : candidate_rows) {
+                if (visited[row]) {
+                    continue;
+                }
+                if (best_before[row] == before) {
+                    find_cheapest(row);
+                    continue;
+                }
+                const long delta_before = costs_(before, row) + costs_(row, chosen) - costs_(before, chosen);
+                if (delta_before < best_delta[row]) {
+                    best_delta[row] = delta_before;
+                    best_before[row] = before;
+                }
+                const long delta_after = costs_(chosen, row) + costs_(row, after) - costs_(chosen, after);
+                if (delta_after < best_delta[row]) {
+                    best_delta[row] = delta_after;
+                    best_before[row] = chosen;
+                }
+            }
+        }
+    }
+
+    // Reverses stretches of the path between the fixed end points while that shortens it.
+    void two_opt(OrienteeringTour& tour) const {
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            for (size_t i = 1; i + 1 < tour.rows.size(); i++) {
+                for (size_t j = i + 1; j + 1 < tour.rows.size(); j++) {
+                    const long delta = costs_(tour.rows[i - 1], tour.rows[j]) + costs_(tour.rows[i], tour.rows[j + 1])
+                        - costs_(tour.rows[i - 1], tour.rows[i]) - costs_(tour.rows[j], tour.rows[j + 1]);
+                    if (delta < 0) {
+                        std::reverse(tour.rows.begin() + i, tour.rows.begin() + j + 1);
+                        tour.cost += delta;
+                        improved = true;
+                    }
+                }
+            }
+        }
+    }
+
+    OrienteeringTour run_start(size_t start, size_t iterations) const {
+        std::mt19937 random(static_cast<std::mt19937::result_type>(start + 1));
+
+        OrienteeringTour best;
+        best.rows = { start_row_, end_row_ };
+        update_totals(best);
+        std::vector<char> visited(scores_.size(), 0);
+        visited[start_row_] = 1;
+        visited[end_row_] = 1;
+        insert_greedy(best, visited, random, start == 0 ? 1 : 3);
+        two_opt(best);
+        insert_greedy(best, visited, random, 1);
+
+        for (size_t iteration = 0; iteration < iterations && best.rows.size() > 2; iteration++) {
+            OrienteeringTour tour = best;
+            const size_t stops = tour.rows.size() - 2;
+            const size_t length = 1 + random() % std::max<size_t>(stops / 5, 1);
+            const size_t first = 1 + random() % (stops - std::min(length, stops) + 1);
+            const size_t last = std::min(first + length, tour.rows.size() - 1);
+
+            std::vector<char> tour_visited(scores_.size(), 0);
+            tour.rows.erase(tour.rows.begin() + first, tour.rows.begin() + last);
+            for (const size_t row : tour.rows) {
+                tour_visited[row] = 1;
+            }
+            update_totals(tour);
+            two_opt(tour);
+            insert_greedy(tour, tour_visited, random, 1);
+            two_opt(tour);
+            insert_greedy(tour, tour_visited, random, 1);
+            if (better(tour, best)) {
+                best = std::move(tour);
+            }
+        }
+        return best;
+    }
+
+    const SymmetricCosts& costs_;
+    const std::vector<double>& scores_;
+    size_t start_row_;
+    size_t end_row_;
+    long cost_limit_;
+};
+
+// evaltours mode: one candidate tour as matrix rows, read from a solver .sol file or from a line of job ids.
+struct CandidateTour {
+    std::string name;
+    std::vector<size_t> rows;
+    std::string error;
+};
+
+// Rows of a solver solution: the one based rows after NODE_SEQUENCE_SECTION up to -1, then the end job
+// (row 1) that resultsymc appends as well.
+std::vector<size_t> read_solution_rows(std::istream& solution, size_t size) {
+    std::string line;
+    while (std::getline(solution, line) && line != "NODE_SEQUENCE_SECTION" && line != "NODE_SEQUENCE_SECTION\r") {
+    }
+    std::vector<size_t> rows;
+    while (std::getline(solution, line)) {
+        long row_one_based = 0;
+        const char* end = line.c_str() + line.size();
+        if (parse_field(line.c_str(), end, row_one_based) == nullptr) {
+            throw std::runtime_error("invalid solution line: " + line);
+        }
+        if (row_one_based == -1) {
+            rows.push_back(1);
+            return rows;
+        }
+        if (row_one_based < 1 || static_cast<size_t>(row_one_based) > size) {
+            throw std::runtime_error("solution row " + line + " is not in the input");
+        }
+        rows.push_back(static_cast<size_t>(row_one_based - 1));
+    }
+    throw std::runtime_error("no NODE_SEQUENCE_SECTION ending with -1");
+}
+
+// A directory is read as one .sol solution per file (in name order). A file holding NODE_SEQUENCE_SECTION is one
+// solution, any other file holds one tour per line as the job ids of the result mode stop list.
+std::vector<CandidateTour> read_candidate_tours(const std::string& path, const std::vector<int>& jobRowToId) {
+    std::vector<CandidateTour> tours;
+    if (std::filesystem::is_directory(path)) {
+        std::vector<std::string> filenames;
+        for (const auto& entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                filenames.push_back(entry.path().string());
+            }
+        }
+        std::sort(filenames.begin(), filenames.end());
+        for (const auto& filename : filenames) {
+            CandidateTour tour;
+            tour.name = filename;
+            try {
+                std::ifstream solution(filename);
+                tour.rows = read_solution_rows(solution, jobRowToId.size());
+            }
+            catch (std::exception& ex) {
+                tour.error = ex.what();
+            }
+            tours.push_back(std::move(tour));
+        }
+        return tours;
+    }
+
+    std::ifstream toursFile(path);
+    if (!toursFile.is_open()) {
+        throw std::runtime_error("error opening tours file " + path);
+    }
+    const std::string content((std::istreambuf_iterator<char>(toursFile)), std::istreambuf_iterator<char>());
+    if (content.find("NODE_SEQUENCE_SECTION") != std::string::npos) {
+        std::istringstream solution(content);
+        tours.push_back({ path, read_solution_rows(solution, jobRowToId.size()), "" });
+        return tours;
+    }
+
+    std::unordered_map<int, size_t> rowOfJobId;
+    for (size_t row = 0; row < jobRowToId.size(); row++) {
+        rowOfJobId[jobRowToId[row]] = row;
+    }
+    std::istringstream lines(content);
+    std::string line;
+    for (size_t line_number = 1; std::getline(lines, line); line_number++) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        CandidateTour tour;
+        tour.name = path + ":" + std::to_string(line_number);
+        std::istringstream lineStream(line);
+        int jobId;
+        while (lineStream >> jobId) {
+            const auto row = rowOfJobId.find(jobId);
+            if (row == rowOfJobId.end()) {
+                tour.error = "job " + std::to_string(jobId) + " is not in the input";
+                break;
+            }
+            tour.rows.push_back(row->second);
+        }
+        tours.push_back(std::move(tour));
+    }
+    return tours;
+}
+
+// Evaluates all tours on thread_count threads, each one a gather over the matrix behind dampedDrivingMinutes(from, to).
+// Errors of single tours (like pairs missing from a sparse matrix) are recorded with the tour.
+template <typename DrivingMinutes>
+std::vector<TourTotals> evaluate_tours(std::vector<CandidateTour>& tours, const JobColumns& jobs, unsigned thread_count, DrivingMinutes dampedDrivingMinutes) {
+    std::vector<TourTotals> totals(tours.size());
+    parallel_for(tours.size(), thread_count, [&](size_t i) {
+        if (!tours[i].error.empty()) {
+            return;
+        }
+        try {
+            const std::vector<size_t>& rows = tours[i].rows;
+            TourTotals& tour = totals[i];
+            for (size_t stop = 0; stop < rows.size(); stop++) {
+                tour.score1Sum += jobs.score1[rows[stop]];
+                tour.workDurationSum += jobs.score2[rows[stop]];
+                if (stop != 0) {
+                    tour.dampedDrivingMinutes += dampedDrivingMinutes(rows[stop - 1], rows[stop]);
+                }
+            }
+            tour.totalHours = (tour.workDurationSum + tour.dampedDrivingMinutes) / 60.0;
+        }
+        catch (std::exception& ex) {
+            tours[i].error = ex.what();
+        }
+    });
+    return totals;
+}
+
+// The evaltours summary, one line per tour.
+void write_tour_summary(std::ostream& outputFile, const std::vector<CandidateTour>& tours, const std::vector<TourTotals>& totals) {
+    outputFile << "tour;stops;score1;worktime_minutes;damped_driving_minutes;total_hours;error" << '\n';
+    for (size_t i = 0; i < tours.size(); i++) {
+        outputFile << tours[i].name << ";";
+        if (tours[i].error.empty()) {
+            outputFile << tours[i].rows.size() << ";" << totals[i].score1Sum << ";" << totals[i].workDurationSum << ";"
+                << std::lround(totals[i].dampedDrivingMinutes) << ";" << std::fixed << std::setprecision(1) << totals[i].totalHours << std::defaultfloat << std::setprecision(6) << ";";
+        }
+        else {
+            outputFile << ";;;;;" << tours[i].error;
+        }
+        outputFile << '\n';
+    }
+}
+
+// The cells of the EDGE_WEIGHT_SECTION of a workdrivesymc text output, packed lower triangle. The header lines before
+// the section are echoed to skipped_lines if given.
+std::vector<long> read_text_matrix_cells(const std::string& filename, size_t size, std::ostream* skipped_lines) {
+    std::ifstream matrixFile(filename);
+    if (!matrixFile.is_open()) {
+        throw std::runtime_error("error opening distance matrix input file " + filename);
+    }
+    std::string line;
+    do {
+        if (!std::getline(matrixFile, line)) {
+            throw std::runtime_error("no EDGE_WEIGHT_SECTION in distance matrix input file " + filename);
+        }
+        if (skipped_lines != nullptr) {
+            *skipped_lines << "SKIPPED distance matrix input line: " << line << std::endl;
+        }
+    } while (line != "EDGE_WEIGHT_SECTION" && line != "EDGE_WEIGHT_SECTION\r");
+
+    std::vector<long> cells;
+    cells.reserve(size * (size + 1) / 2);
+    for (size_t row = 0; row < size && std::getline(matrixFile, line); row++) {
+        parse_matrix_line(line, 0, cells);
+    }
+    if (cells.size() != size * (size + 1) / 2) {
+        throw std::runtime_error("distance matrix input file " + filename + " does not hold the LOWER_DIAG_ROW matrix of the input");
+    }
+    return cells;
+}
+
+// Damped driving minutes of a leg as resultsymc derives them from a workdrivesymc cell: the cell minus half the work duration
+// of its row and of its column, as an integer (the row is the later job of the pair).
+int symmetric_leg_minutes(long cell, double workRowDuration, double workColumnDuration) {
+    int minutes = cell;
+    minutes -= workRowDuration / 2.0;
+    minutes -= workColumnDuration / 2.0;
+    return minutes;
+}
+
+// The driving cost of tour legs for result, resultsymc and evaltours, from whichever matrix was loaded: a workdrivesymc text
+// output, a binary matrix, a sparse edge list or the routed durations of the tour stops. The routed formats compute the
+// workdrivesymc cell of a leg as it would have been written, so symmetric_minutes gives the same report for every format.
+class LegCosts {
+public:
+    LegCosts(const JobColumns& jobs, std::string matrixName) : jobs_(jobs), matrixName_(std::move(matrixName)) {
+    }
+
+    void use_text_cells(std::vector<long> cells) {
+        cells_ = std::move(cells);
+        text_ = true;
+    }
+
+    void use_binary(const BinaryMatrix& binary) {
+        binary_ = &binary;
+        dampeningFactor_ = binary.header->dampeningFactor;
+    }
+
+    void use_sparse(const SparseMatrix& sparse) {
+        sparse_ = &sparse;
+        dampeningFactor_ = sparse.dampeningFactor;
+    }
+
+    // stopDurations is the table between the distinct tour stops, stopIndexOfRow maps a job row to its stop
+    void use_stops(const DurationMatrix& stopDurations, const std::vector<size_t>& stopIndexOfRow, double dampeningFactor) {
+        stops_ = &stopDurations;
+        stopIndexOfRow_ = &stopIndexOfRow;
+        dampeningFactor_ = dampeningFactor;
+    }
+
+    // Routed seconds of the leg, not known for a text matrix.
+    double seconds(size_t from, size_t to) const {
+        if (binary_ != nullptr) {
+            return binary_->seconds(from, to);
+        }
+        if (sparse_ != nullptr) {
+            double seconds;
+            if (!sparse_->seconds(from, to, seconds)) {
+                throw std::runtime_error("the tour uses the pair " + std::to_string(jobs_.ids[from]) + " - " + std::to_string(jobs_.ids[to])
+                    + " that is not in the sparse matrix " + matrixName_);
+            }
+            return seconds;
+        }
+        if (stops_ != nullptr) {
+            return stops_->at((*stopIndexOfRow_)[from], (*stopIndexOfRow_)[to]);
+        }
+        throw std::runtime_error("the distance matrix " + matrixName_ + " holds no routed seconds");
+    }
+
+    // Damped driving minutes of the leg as resultsymc reports them from the LOWER_DIAG_ROW cell of the pair.
+    int symmetric_minutes(size_t from, size_t to) const {
+        const size_t row = std::max(from, to);
+        const size_t column = std::min(from, to);
+        const long cell = text_
+            ? cells_[row * (row + 1) / 2 + column]
+            : output_cell(WorkMode::workdrivesymc, seconds(row, column), dampeningFactor_, jobs_.score2[row], jobs_.score2[column]);
+        return symmetric_leg_minutes(cell, jobs_.score2[row], jobs_.score2[column]);
+    }
+
+private:
+    const JobColumns& jobs_;
+    const std::string matrixName_;
+    bool text_ = false;
+    std::vector<long> cells_;
+    const BinaryMatrix* binary_ = nullptr;
+    const SparseMatrix* sparse_ = nullptr;
+    const DurationMatrix* stops_ = nullptr;
+    const std::vector<size_t>* stopIndexOfRow_ = nullptr;
+    double dampeningFactor_ = 1.0;
+};
+
+// The result mode report after the two echoed input lines: work minutes, damped driving minutes and hours of the tour,
+// then one "job;driving minutes from the previous job;work minutes;" line per stop.
+void write_result_report(std::ostream& outputFile, const JobColumns& jobs, const std::vector<int>& jobIds, const std::vector<size_t>& tourRows,
+    const LegCosts& legCosts, double dampeningFactor) {
+    // seconds of the leg ending at tour stop i
+    auto drivingSeconds = [&](size_t i) -> double {
+        return legCosts.seconds(tourRows[i - 1], tourRows[i]);
+    };
+
+    double workDurationSum = 0;
+    for (size_t i = 0; i < jobIds.size(); i++) {
+        workDurationSum += jobs.score2[tourRows[i]];
+    }
+    outputFile << workDurationSum << '\n';
+
+    double baseDrivingTimeSum = 0;
+    for (size_t i = 1; i < jobIds.size(); i++) {
+        baseDrivingTimeSum += drivingSeconds(i);
+    }
+    const double drivingTimeSumMinutes = baseDrivingTimeSum * dampeningFactor / 60.0;
+    outputFile << std::lround(drivingTimeSumMinutes) << '\n';
+
+    const double totalTimeHours = (workDurationSum + drivingTimeSumMinutes)/60.0;
+    outputFile << std::fixed << std::setprecision(1) << totalTimeHours << std::setprecision(0) << '\n';
+
+    for (size_t i = 0; i < jobIds.size(); i++) {
+        int drivingTimeFromPreviousJob = 0;
+        if (i != 0) {
+            drivingTimeFromPreviousJob = std::lround(drivingSeconds(i)* dampeningFactor / 60.0);
+        }
+        outputFile << jobIds[i] << ";" << drivingTimeFromPreviousJob << ";" << jobs.score2[tourRows[i]] << ";" << "\n";
+    }
+}
+
+// benchparse mode: parses INPUT with the former getline/istringstream loop and with parse_jobs on the mapped file
+// and reports the throughput of both.
+void benchmark_parsers(const std::string& inputFilename, std::ostream& report, size_t repetitions) {
+    using Clock = std::chrono::steady_clock;
+
+    size_t bytes = 0;
+    size_t stream_jobs = 0;
+    size_t column_jobs = 0;
+    double stream_seconds = 0;
+    double column_seconds = 0;
+    for (size_t repetition = 0; repetition < repetitions; repetition++) {
+        {
+            const auto start = Clock::now();
+            std::ifstream inputFile(inputFilename);
+            if (!inputFile.is_open()) {
+                throw std::runtime_error("error opening input file " + inputFilename);
+            }
+            std::vector<osrm::util::Coordinate> coordinates;
+            std::vector<int> jobRowToId;
+            std::unordered_map<int, double> workDurationMap;
+            std::unordered_map<int, double> score1Map;
+            std::string line;
+            while (std::getline(inputFile, line)) {
+                int uniqueJobID;
+                double latitude;
+                double longitude;
+                double score1;
+                double score2;
+                if (!parse_job_line(line, uniqueJobID, latitude, longitude, score1, score2)) {
+                    continue;
+                }
+                coordinates.push_back({ osrm::util::FloatLongitude{longitude}, osrm::util::FloatLatitude{latitude} });
+                jobRowToId.push_back(uniqueJobID);
+                workDurationMap[uniqueJobID] = score2;
+                score1Map[uniqueJobID] = score1;
+            }
+            stream_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            stream_jobs = jobRowToId.size();
+        }
+        {
+            const auto start = Clock::now();
+            const MappedFile inputFile(inputFilename);
+            JobColumns jobs;
+            parse_jobs(inputFile.data(), inputFile.data() + inputFile.size(), jobs, [](std::string_view) {}, [](std::string_view) {});
+            const std::vector<osrm::util::Coordinate> coordinates = jobs.coordinates();
+            column_seconds += std::chrono::duration<double>(Clock::now() - start).count();
+            column_jobs = jobs.size();
+            bytes = inputFile.size();
+        }
+    }
+    if (stream_jobs != column_jobs) {
+        throw std::runtime_error("parsers disagree: " + std::to_string(stream_jobs) + " jobs with istringstream, " + std::to_string(column_jobs) + " with parse_jobs");
+    }
+
+    const double megabytes = bytes / 1e6;
+    report << "parser;jobs;bytes;seconds per pass;MB/s" << '\n';
+    report << "istringstream;" << stream_jobs << ";" << bytes << ";" << stream_seconds / repetitions << ";" << megabytes * repetitions / stream_seconds << '\n';
+    report << "mmap from_chars;" << column_jobs << ";" << bytes << ";" << column_seconds / repetitions << ";" << megabytes * repetitions / column_seconds << '\n';
+    report << "speedup;" << stream_seconds / column_seconds << '\n';
+}
+
+// bench mode: generated jobs spread over a box around Germany. Jobs 0 and 1 are the depot (start and end of the tours)
+// with no score and no work, the others get random scores and work durations. The same size and seed give the same jobs.
+void write_generated_jobs(const std::string& filename, size_t size, unsigned seed) {
+    std::ofstream jobsFile(filename);
+    if (!jobsFile.is_open()) {
+        throw std::runtime_error("error writing output file " + filename);
+    }
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> latitude(47.5, 54.8);
+    std::uniform_real_distribution<double> longitude(6.0, 14.9);
+    std::uniform_int_distribution<int> score1(1, 100);
+    std::uniform_int_distribution<int> score2(10, 120);
+    jobsFile << std::fixed << std::setprecision(6);
+    for (size_t row = 0; row < size; row++) {
+        if (row < 2) {
+            jobsFile << row << ",51.165691,10.451526,0,0" << '\n';
+        }
+        else {
+            jobsFile << row << "," << latitude(random) << "," << longitude(random) << "," << score1(random) << "," << score2(random) << '\n';
+        }
+    }
+}
+
+// Measures the phases of every mode (parse, routing, post-processing into output cells, writing the output) for each size.
+// drive, workdrive, workdrivesymc and solve hold the whole matrix and are skipped above max_full_size, so are resultsymc and
+// evaltours, which read the workdrivesymc output (reading it counts as their post-processing). sparse routes 20 neighbours
+// per job, result and resultsymc report a tour over the first 100 jobs, evaltours sums 1000 random tours of 20 stops and
+// solve post-processes into the solver. Scratch files are written next to scratchPrefix and removed again.
+void benchmark_modes(const RoutingBackend& backend, const std::vector<size_t>& sizes, size_t max_full_size, const std::string& scratchPrefix,
+    unsigned thread_count, std::ostream& report) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds_since = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    const std::string inputFilename = scratchPrefix + "bench-input.txt";
+    const std::string outputFilename = scratchPrefix + "bench-output.txt";
+    // the workdrivesymc output is kept for resultsymc and evaltours, which read it like the modes do
+    const std::string matrixFilename = scratchPrefix + "bench-workdrivesymc.txt";
+    const double dampeningFactor = 1.2;
+    const long cost_limit = 2400;
+
+    report << "mode;jobs;parse seconds;routing seconds;post-processing seconds;output seconds;output bytes" << '\n';
+    for (const size_t size : sizes) {
+        write_generated_jobs(inputFilename, size, static_cast<unsigned>(size));
+
+        auto start = Clock::now();
+        JobColumns jobs;
+        {
+            const MappedFile inputFile(inputFilename);
+            parse_jobs(inputFile.data(), inputFile.data() + inputFile.size(), jobs, [](std::string_view) {}, [](std::string_view) {});
+        }
+        const std::vector<osrm::util::Coordinate> coordinates = jobs.coordinates();
+        const double parse_seconds = seconds_since(start);
+        std::vector<size_t> allRows(size);
+        std::iota(allRows.begin(), allRows.end(), 0);
+
+        // a tour over the first (up to) 100 jobs, from job 0 to job 1 like a solver solution
+        std::vector<size_t> tourRows(std::min<size_t>(size, 100));
+        std::iota(tourRows.begin(), tourRows.end(), 0);
+        if (tourRows.size() > 1) {
+            std::rotate(tourRows.begin() + 1, tourRows.begin() + 2, tourRows.end());
+        }
+
+        // every WorkMode that turns jobs into an output, the bench modes and batch only run the others
+        const std::pair<WorkMode, const char*> modes[] = { { WorkMode::drive, "drive" }, { WorkMode::workdrive, "workdrive" },
+            { WorkMode::workdrivesymc, "workdrivesymc" }, { WorkMode::sparse, "sparse" }, { WorkMode::result, "result" },
+            { WorkMode::resultsymc, "resultsymc" }, { WorkMode::solve, "solve" }, { WorkMode::evaltours, "evaltours" } };
+        for (const auto& entry : modes) {
+            const WorkMode mode = entry.first;
+            const char* name = entry.second;
+            const bool full_matrix = mode == WorkMode::drive || mode == WorkMode::workdrive || mode == WorkMode::workdrivesymc || mode == WorkMode::solve;
+            // resultsymc and evaltours read the workdrivesymc output, so they need its full matrix as well
+            const bool reads_matrix = mode == WorkMode::resultsymc || mode == WorkMode::evaltours;
+            if ((full_matrix || reads_matrix) && size > max_full_size) {
+                report << name << ";" << size << ";skipped above " << max_full_size << " jobs" << '\n';
+                continue;
+            }
+
+            double routing_seconds = 0;
+            double postprocess_seconds = 0;
+            double output_seconds = 0;
+            std::ofstream outputFile(mode == WorkMode::workdrivesymc ? matrixFilename : outputFilename, std::ios::binary);
+            if (mode == WorkMode::solve) {
+                start = Clock::now();
+                const DurationMatrix durations_matrix = query_lower_triangle_durations(backend, coordinates, default_triangle_tile_size, thread_count, Symmetrisation::none);
+                routing_seconds = seconds_since(start);
+
+                start = Clock::now();
+                SymmetricCosts costs;
+                costs.cells.resize(size * (size + 1) / 2);
+                parallel_for(size, thread_count, [&](size_t indexFrom) {
+                    std::vector<long> row(indexFrom + 1);
+                    output_cells(best_cell_kernel(), WorkMode::workdrivesymc, durations_matrix.row(indexFrom), indexFrom + 1, dampeningFactor,
+                        jobs.score2[indexFrom], jobs.score2.data(), row.data());
+                    std::copy(row.begin(), row.end(), costs.cells.begin() + indexFrom * (indexFrom + 1) / 2);
+                });
+                const OrienteeringSolver solver(costs, jobs.score1, 0, std::min<size_t>(1, size - 1), cost_limit);
+                const OrienteeringTour tour = solver.solve(default_solver_starts, 200, thread_count);
+                postprocess_seconds = seconds_since(start);
+
+                start = Clock::now();
+                for (const size_t row : tour.rows) {
+                    outputFile << jobs.ids[row] << " ";
+                }
+                outputFile << '\n';
+                TourTotals totals;
+                for (const size_t row : tour.rows) {
+                    totals.score1Sum += jobs.score1[row];
+                    totals.workDurationSum += jobs.score2[row];
+                }
+                write_tour_report(outputFile, jobs, tour.rows, totals, [&](size_t from, size_t to) -> double {
+                    return symmetric_leg_minutes(costs(from, to), jobs.score2[std::max(from, to)], jobs.score2[std::min(from, to)]);
+                });
+                outputFile.flush();
+                output_seconds = seconds_since(start);
+            }
+            else if (reads_matrix) {
+                start = Clock::now();
+                LegCosts legCosts(jobs, matrixFilename);
+                legCosts.use_text_cells(read_text_matrix_cells(matrixFilename, size, nullptr));
+                postprocess_seconds = seconds_since(start);
+
+                start = Clock::now();
+                if (mode == WorkMode::resultsymc) {
+                    TourTotals totals;
+                    for (const size_t row : tourRows) {
+                        totals.score1Sum += jobs.score1[row];
+                        totals.workDurationSum += jobs.score2[row];
+                    }
+                    write_tour_report(outputFile, jobs, tourRows, totals, [&](size_t from, size_t to) -> double {
+                        return legCosts.symmetric_minutes(from, to);
+                    });
+                }
+                else {
+                    // 1000 tours of 20 stops between jobs 0 and 1
+                    std::mt19937 random(static_cast<unsigned>(size));
+                    std::uniform_int_distribution<size_t> stop(0, size - 1);
+                    std::vector<CandidateTour> tours(1000);
+                    for (size_t i = 0; i < tours.size(); i++) {
+                        tours[i].name = std::to_string(i + 1);
+                        tours[i].rows.push_back(0);
+                        for (size_t j = 0; j < 20; j++) {
+                            tours[i].rows.push_back(stop(random));
+                        }
+                        tours[i].rows.push_back(std::min<size_t>(1, size - 1));
+                    }
+                    const std::vector<TourTotals> totals = evaluate_tours(tours, jobs, thread_count, [&](size_t from, size_t to) -> double {
+                        return legCosts.symmetric_minutes(from, to);
+                    });
+                    write_tour_summary(outputFile, tours, totals);
+                }
+                outputFile.flush();
+                output_seconds = seconds_since(start);
+            }
+            else if (full_matrix) {
+                start = Clock::now();
+                const DurationMatrix durations_matrix = mode == WorkMode::workdrivesymc
+                    ? query_lower_triangle_durations(backend, coordinates, default_triangle_tile_size, thread_count, Symmetrisation::none)
+                    : query_table_durations(backend, coordinates, allRows, allRows, 0, thread_count);
+                routing_seconds = seconds_since(start);
+
+                start = Clock::now();
+                const bool lower = mode == WorkMode::workdrivesymc;
+                std::vector<long> cells(lower ? size * (size + 1) / 2 : size * size);
+                parallel_for(size, thread_count, [&](size_t indexFrom) {
+                    long* row = cells.data() + (lower ? indexFrom * (indexFrom + 1) / 2 : indexFrom * size);
+                    output_cells(best_cell_kernel(), mode, durations_matrix.row(indexFrom), lower ? indexFrom + 1 : size, dampeningFactor,
+                        jobs.score2[indexFrom], jobs.score2.data(), row);
+                });
+                postprocess_seconds = seconds_since(start);
+
+                start = Clock::now();
+                if (lower) {
+                    write_op_header(outputFile, matrixFilename, inputFilename, size, std::to_string(cost_limit));
+                }
+                write_matrix_text(outputFile, size, lower ? MatrixTextFormat::lower_diag_row : MatrixTextFormat::drive,
+                    [&](size_t indexFrom, std::vector<long>& row) {
+                        const long* first = cells.data() + (lower ? indexFrom * (indexFrom + 1) / 2 : indexFrom * size);
+                        std::copy(first, first + (lower ? indexFrom + 1 : size), row.begin());
+                    }, thread_count);
+                if (lower) {
+                    write_op_footer(outputFile, jobs);
+                }
+                outputFile.flush();
+                output_seconds = seconds_since(start);
+            }
+            else if (mode == WorkMode::sparse) {
+                start = Clock::now();
+                SparseMatrix sparse = query_sparse_durations(backend, jobs, coordinates, 20, thread_count);
+                routing_seconds = seconds_since(start);
+
+                start = Clock::now();
+                sparse.dampeningFactor = dampeningFactor;
+                write_sparse_matrix(outputFile, outputFilename, inputFilename, 20, jobs.ids, sparse);
+                outputFile.flush();
+                output_seconds = seconds_since(start);
+            }
+            else {
+                // result: the legs of the tour are routed as a stops x stops table, like result mode without --matrix
+                start = Clock::now();
+                const DurationMatrix stopDurations = query_table_durations(backend, coordinates, tourRows, tourRows, 0, thread_count);
+                std::vector<size_t> stopIndexOfRow(size, 0);
+                for (size_t stop = 0; stop < tourRows.size(); stop++) {
+                    stopIndexOfRow[tourRows[stop]] = stop;
+                }
+                LegCosts legCosts(jobs, "the bench tour");
+                legCosts.use_stops(stopDurations, stopIndexOfRow, dampeningFactor);
+                routing_seconds = seconds_since(start);
+
+                start = Clock::now();
+                std::vector<int> jobIds;
+                for (const size_t row : tourRows) {
+                    jobIds.push_back(jobs.ids[row]);
+                }
+                postprocess_seconds = seconds_since(start);
+
+                start = Clock::now();
+                write_result_report(outputFile, jobs, jobIds, tourRows, legCosts, dampeningFactor);
+                outputFile.flush();
+                output_seconds = seconds_since(start);
+            }
+            const auto output_bytes = static_cast<long long>(outputFile.tellp());
+            outputFile.close();
+            report << name << ";" << size << ";" << parse_seconds << ";" << routing_seconds << ";" << postprocess_seconds << ";" << output_seconds << ";" << output_bytes << '\n';
+        }
+    }
+    std::remove(inputFilename.c_str());
+    std::remove(outputFilename.c_str());
+    std::remove(matrixFilename.c_str());
+}
+
+// Post-processing of a size x size matrix of generated durations (whole deciseconds up to 10 hours) with every cell kernel
+// the CPU supports, single threaded, against the per cell output_cell loop. Cells that differ from the loop are counted.
+void benchmark_cell_kernels(const std::vector<size_t>& sizes, size_t max_full_size, std::ostream& report) {
+    using Clock = std::chrono::steady_clock;
+    std::vector<CellKernel> kernels = { CellKernel::scalar };
+#ifdef TABLE_X86_64
+    kernels.push_back(CellKernel::sse2);
+    if (best_cell_kernel() == CellKernel::avx2) {
+        kernels.push_back(CellKernel::avx2);
+    }
+#endif
+    const double dampeningFactor = 1.2;
+
+    report << "kernel;mode;jobs;loop seconds;kernel seconds;speedup;mismatches" << '\n';
+    for (const size_t size : sizes) {
+        if (size > max_full_size) {
+            continue;
+        }
+        std::mt19937 random(static_cast<unsigned>(size));
+        std::uniform_int_distribution<int> deciseconds(0, 360000);
+        std::uniform_int_distribution<int> work(10, 120);
+        std::vector<float> durations(size * size);
+        std::vector<double> workDurations(size);
+        for (auto& duration : durations) {
+            duration = static_cast<float>(deciseconds(random) / 10.0);
+        }
+        for (auto& workDuration : workDurations) {
+            workDuration = work(random);
+        }
+
+        std::vector<long> expected(size * size);
+        std::vector<long> cells(size * size);
+        for (const WorkMode mode : { WorkMode::drive, WorkMode::workdrive, WorkMode::workdrivesymc }) {
+            const char* name = mode == WorkMode::drive ? "drive" : mode == WorkMode::workdrive ? "workdrive" : "workdrivesymc";
+            auto start = Clock::now();
+            for (size_t indexFrom = 0; indexFrom < size; indexFrom++) {
+                const float* row = durations.data() + indexFrom * size;
+                for (size_t indexTo = 0; indexTo < size; indexTo++) {
+                    expected[indexFrom * size + indexTo] = output_cell(mode, DurationMatrix::seconds(row[indexTo]), dampeningFactor, workDurations[indexFrom], workDurations[indexTo]);
+                }
+            }
+            const double loop_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            for (const CellKernel kernel : kernels) {
+                start = Clock::now();
+                for (size_t indexFrom = 0; indexFrom < size; indexFrom++) {
+                    output_cells(kernel, mode, durations.data() + indexFrom * size, size, dampeningFactor, workDurations[indexFrom], workDurations.data(), cells.data() + indexFrom * size);
+                }
+                const double kernel_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                size_t mismatches = 0;
+                for (size_t cell = 0; cell < cells.size(); cell++) {
+                    mismatches += cells[cell] != expected[cell] ? 1 : 0;
+                }
+                report << cell_kernel_name(kernel) << ";" << name << ";" << size << ";" << loop_seconds << ";" << kernel_seconds << ";"
+                    << (kernel_seconds > 0 ? loop_seconds / kernel_seconds : 0.0) << ";" << mismatches << '\n';
+            }
+        }
+    }
+}
+
+// How the OSRM engine is set up: --algorithm=ch|mld and --shared-memory [--dataset-name=NAME] to attach to the data
+// osrm-datastore keeps in shared memory instead of loading the .osrm files into the process.
+struct EngineSettings {
+    osrm::EngineConfig::Algorithm algorithm = osrm::EngineConfig::Algorithm::MLD;
+    bool shared_memory = false;
+    std::string dataset_name;
+
+    std::string name() const {
+        const std::string algorithm_name = algorithm == osrm::EngineConfig::Algorithm::CH ? "ch" : "mld";
+        return shared_memory ? algorithm_name + "-shm" + (dataset_name.empty() ? std::string() : ":" + dataset_name) : algorithm_name;
+    }
+};
+
+// Parses a setup name as --algorithm takes it, with a "-shm" suffix for shared memory (ch, mld, ch-shm, mld-shm).
+EngineSettings parse_engine_settings(const std::string& value, const std::string& dataset_name) {
+    EngineSettings settings;
+    std::string algorithm = value;
+    const std::string shared_suffix = "-shm";
+    if (algorithm.size() > shared_suffix.size() && algorithm.compare(algorithm.size() - shared_suffix.size(), shared_suffix.size(), shared_suffix) == 0) {
+        settings.shared_memory = true;
+        algorithm.resize(algorithm.size() - shared_suffix.size());
+    }
+    if (algorithm == "ch") {
+        settings.algorithm = osrm::EngineConfig::Algorithm::CH;
+    }
+    else if (algorithm != "mld") {
+        throw std::runtime_error("invalid value for --algorithm: " + value + ". Supported values: ch, mld.");
+    }
+    settings.dataset_name = dataset_name;
+    return settings;
+}
+
+EngineSettings engine_settings(const CommandLineOptions& options) {
+    EngineSettings settings = parse_engine_settings(options.count("algorithm") != 0 ? options.at("algorithm") : std::string("mld"),
+        options.count("dataset-name") != 0 ? options.at("dataset-name") : std::string());
+    settings.shared_memory = settings.shared_memory || options.count("shared-memory") != 0;
+    return settings;
+}
+
+osrm::EngineConfig make_engine_config(const std::string& pathToOsrmFile, const EngineSettings& settings) {
+    using namespace osrm;
+
+    // Configure based on a .osrm base path, or attach to the datasets in shared mem from osrm-datastore
+    EngineConfig config;
+
+    if (settings.shared_memory) {
+        config.use_shared_memory = true;
+        config.dataset_name = settings.dataset_name;
+    }
+    else {
+        config.storage_config = { pathToOsrmFile };
+        config.use_shared_memory = false;
+    }
+
+    // We support two routing speed up techniques:
+    // - Contraction Hierarchies (CH): requires extract+contract pre-processing
+    // - Multi-Level Dijkstra (MLD): requires extract+partition+customize pre-processing
+    config.algorithm = settings.algorithm;
+
+    return config;
+}
+
+// benchalgo mode: loads the engine once per setup and times its load and the full jobs x jobs table (first query and best
+// of repetitions, with the usual --tile-size and --threads), compared cell by cell to the first setup that loaded.
+// A setup that cannot be loaded, for example CH on data that was only partitioned for MLD, is reported with its error.
+void benchmark_algorithms(const std::string& pathToOsrmFile, const std::vector<EngineSettings>& setups, const std::vector<osrm::util::Coordinate>& coordinates,
+    size_t tile_size, unsigned thread_count, size_t repetitions, std::ostream& report) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds_since = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    std::vector<size_t> allRows(coordinates.size());
+    std::iota(allRows.begin(), allRows.end(), 0);
+
+    DurationMatrix reference;
+    std::string referenceName;
+    report << "setup;jobs;load seconds;first table seconds;best table seconds;max difference seconds;differing cells;error" << '\n';
+    for (const auto& settings : setups) {
+        report << settings.name() << ";" << coordinates.size() << ";";
+        try {
+            auto start = Clock::now();
+            const OsrmBackend backend(make_engine_config(pathToOsrmFile, settings), settings.name());
+            const double load_seconds = seconds_since(start);
+
+            double first_seconds = 0;
+            double best_seconds = 0;
+            DurationMatrix durations_matrix;
+            for (size_t repetition = 0; repetition < std::max<size_t>(1, repetitions); repetition++) {
+                start = Clock::now();
+                durations_matrix = query_table_durations(backend, coordinates, allRows, allRows, tile_size, thread_count);
+                const double seconds = seconds_since(start);
+                first_seconds = repetition == 0 ? seconds : first_seconds;
+                best_seconds = repetition == 0 ? seconds : std::min(best_seconds, seconds);
+            }
+
+            double max_difference = 0;
+            size_t differing_cells = 0;
+            if (referenceName.empty()) {
+                reference = std::move(durations_matrix);
+                referenceName = settings.name();
+            }
+            else {
+                for (size_t cell = 0; cell < reference.values.size(); cell++) {
+                    const double difference = std::abs(DurationMatrix::seconds(durations_matrix.values[cell]) - DurationMatrix::seconds(reference.values[cell]));
+                    max_difference = std::max(max_difference, difference);
+                    differing_cells += difference > 0 ? 1 : 0;
+                }
+            }
+            report << load_seconds << ";" << first_seconds << ";" << best_seconds << ";" << max_difference << ";" << differing_cells << ";" << '\n';
+        }
+        catch (std::exception& ex) {
+            report << ";;;;;" << ex.what() << '\n';
+        }
+    }
+    if (!referenceName.empty()) {
+        report << "differences are against " << referenceName << '\n';
+    }
+}
+
+// Name, size and modification time of every file of the dataset (the files next to the .osrm base whose name starts with it),
+// hashed into a hex string. osrm-extract, osrm-contract and osrm-customize rewrite these files, which changes the fingerprint.
+std::string dataset_fingerprint(const std::string& pathToOsrmFile) {
+    const std::filesystem::path base(pathToOsrmFile);
+    const std::filesystem::path directory = base.has_parent_path() ? base.parent_path() : std::filesystem::path(".");
+    const std::string prefix = base.filename().string();
+
+    std::vector<std::string> files;
+    std::error_code error;
+    for (std::filesystem::directory_iterator entry(directory, error), end; !error && entry != end; entry.increment(error)) {
+        const std::string name = entry->path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0 || !entry->is_regular_file(error)) {
+            continue;
+        }
+        const auto size = entry->file_size(error);
+        const auto modified = entry->last_write_time(error).time_since_epoch().count();
+        files.push_back(name + ";" + std::to_string(size) + ";" + std::to_string(modified));
+    }
+    std::sort(files.begin(), files.end());
+
+    std::uint64_t hash = std::hash<std::string>()(prefix);
+    for (const auto& file : files) {
+        hash = hash * 1099511628211ull ^ std::hash<std::string>()(file);
+    }
+    std::ostringstream fingerprint;
+    fingerprint << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return fingerprint.str();
+}
+
+// --hints-cache=FILE: the OSRM snapping hints of earlier runs, keyed by job id and coordinate. A job whose coordinate is unchanged
+// passes its hint to the Table queries and OSRM does not snap it again. The file starts with "HINTS <dataset fingerprint>"
+// followed by one "id lon lat hint" line per job, coordinates in OSRM fixed point. All hints are dropped when the fingerprint
+// of the loaded routing data differs (in shared memory only the dataset name is known, OSRM itself ignores hints whose
+// checksum does not match the data). Safe to share between the commands of a batch.
+class HintsCache {
+public:
+    HintsCache(const std::string& filename, const std::string& fingerprint) : filename_(filename), fingerprint_(fingerprint) {
+        std::ifstream file(filename);
+        std::string line;
+        if (!file.is_open() || !std::getline(file, line)) {
+            return;
+        }
+        if (line != "HINTS " + fingerprint) {
+            std::cout << "hints cache " << filename << " was written for other routing data, its hints are not used" << std::endl;
+            dirty_ = true;
+            return;
+        }
+        while (std::getline(file, line)) {
+            std::istringstream fields(line);
+            int id;
+            Entry entry;
+            if (fields >> id >> entry.lon >> entry.lat >> entry.hint) {
+                entries_[id] = std::move(entry);
+            }
+        }
+    }
+
+    // Hint of every listed job row, empty where the job is unknown or has moved. Returns the number of hints found.
+    size_t lookup(const std::vector<int>& jobRowToId, const std::vector<osrm::util::Coordinate>& coordinates, const std::vector<size_t>& rows,
+        SnappingHints& hints) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t found = 0;
+        for (size_t i = 0; i < rows.size(); i++) {
+            const auto entry = entries_.find(jobRowToId[rows[i]]);
+            if (entry != entries_.end() && entry->second.lon == static_cast<std::int32_t>(coordinates[rows[i]].lon.__value)
+                && entry->second.lat == static_cast<std::int32_t>(coordinates[rows[i]].lat.__value)) {
+                hints.hints[i] = entry->second.hint;
+                found++;
+            }
+        }
+        return found;
+    }
+
+    // Stores the hints the queries returned and rewrites the file if any of them is new.
+    void update(const std::vector<int>& jobRowToId, const std::vector<osrm::util::Coordinate>& coordinates, const std::vector<size_t>& rows,
+        const SnappingHints& hints) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (hints.hints[i].empty()) {
+                continue;
+            }
+            Entry entry;
+            entry.lon = static_cast<std::int32_t>(coordinates[rows[i]].lon.__value);
+            entry.lat = static_cast<std::int32_t>(coordinates[rows[i]].lat.__value);
+            entry.hint = hints.hints[i];
+            auto& stored = entries_[jobRowToId[rows[i]]];
+            if (stored.lon != entry.lon || stored.lat != entry.lat || stored.hint != entry.hint) {
+                stored = std::move(entry);
+                dirty_ = true;
+            }
+        }
+        if (!dirty_) {
+            return;
+        }
+
+        // written next to the cache and renamed over it, so an interrupted run leaves the previous cache intact
+        const std::string temporaryFilename = filename_ + ".tmp";
+        {
+            std::ofstream file(temporaryFilename, std::ios::trunc);
+            if (!file.is_open()) {
+                throw std::runtime_error("error opening hints cache " + temporaryFilename);
+            }
+            file << "HINTS " << fingerprint_ << '\n';
+            for (const auto& entry : entries_) {
+                file << entry.first << ' ' << entry.second.lon << ' ' << entry.second.lat << ' ' << entry.second.hint << '\n';
+            }
+            if (!file.flush()) {
+                throw std::runtime_error("error writing hints cache " + temporaryFilename);
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryFilename, filename_, error);
+        if (error) {
+            throw std::runtime_error("error replacing hints cache " + filename_ + ": " + error.message());
+        }
+        dirty_ = false;
+    }
+
+    const std::string& fingerprint() const {
+        return fingerprint_;
+    }
+
+private:
+    struct Entry {
+        std::int32_t lon = 0;
+        std::int32_t lat = 0;
+        std::string hint;
+    };
+
+    const std::string filename_;
+    const std::string fingerprint_;
+    std::map<int, Entry> entries_;
+    bool dirty_ = false;
+    mutable std::mutex mutex_;
+};
+
+// Routing backends by .osrm path (or synthetic speed with --backend=synthetic). Each dataset is loaded once, on first use,
+// and then shared by all commands of the process; OSRM queries are safe to run concurrently on one instance.
+class EngineCache {
+public:
+    const RoutingBackend& get(const std::string& pathToOsrmFile, const CommandLineOptions& options) {
+        const auto backend = options.find("backend");
+        const bool synthetic = backend != options.end() && backend->second == "synthetic";
+        if (backend != options.end() && !synthetic && backend->second != "osrm") {
+            throw std::runtime_error("invalid value for --backend: " + backend->second + ". Supported values: osrm, synthetic.");
+        }
+        const double speed = synthetic && options.count("synthetic-speed") != 0 ? std::stod(options.at("synthetic-speed")) : 50.0;
+        const double asymmetry = synthetic && options.count("synthetic-asymmetry") != 0 ? std::stod(options.at("synthetic-asymmetry")) : 0.0;
+        const EngineSettings settings = engine_settings(options);
+        // commands with another algorithm or data source get an engine of their own, the path does not matter in shared memory
+        const std::string key = synthetic ? "synthetic:" + std::to_string(speed) + ":" + std::to_string(asymmetry)
+            : settings.name() + (settings.shared_memory ? std::string() : ":" + pathToOsrmFile);
+
+        Entry* entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& slot = entries_[key];
+            if (!slot) {
+                slot.reset(new Entry);
+            }
+            entry = slot.get();
+        }
+        std::call_once(entry->loaded, [&]() {
+            if (synthetic) {
+                entry->backend.reset(new SyntheticBackend(speed, asymmetry));
+            }
+            else {
+                entry->backend.reset(new OsrmBackend(make_engine_config(pathToOsrmFile, settings),
+                    settings.shared_memory ? "shared-memory:" + settings.dataset_name : dataset_fingerprint(pathToOsrmFile)));
+            }
+        });
+        return *entry->backend;
+    }
 
-#include "osrm/osrm.hpp"
-#include "osrm/status.hpp"
+    // The hints cache of filename for the given routing data, loaded once and shared by all commands of a batch.
+    HintsCache& hints(const std::string& filename, const RoutingBackend& backend) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& cache = hints_[filename + "\n" + backend.fingerprint()];
+        if (!cache) {
+            cache.reset(new HintsCache(filename, backend.fingerprint()));
+        }
+        return *cache;
+    }
 
-#include <exception>
-#include <iostream>
-#include <string>
-#include <utility>
-#include <iomanip>
-#include <cstdlib>
-#include <unordered_map>
-#include <unordered_set>
+private:
+    struct Entry {
+        std::once_flag loaded;
+        std::unique_ptr<const RoutingBackend> backend;
+    };
 
-enum class WorkMode {
-    drive,
-    workdrive,
-    result,
-    workdrivesymc,
-    resultsymc
+    std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<Entry>> entries_;
+    std::map<std::string, std::unique_ptr<HintsCache>> hints_;
 };
 
-WorkMode parse_work_mode(const std::string& mode) {
-    if (mode == "drive") {
-        return WorkMode::drive;
+// Splits a batch command line at blanks, double quotes group arguments that contain blanks.
+std::vector<std::string> split_command_line(const std::string& line) {
+    std::vector<std::string> arguments;
+    std::string argument;
+    bool in_argument = false;
+    bool in_quotes = false;
+    for (const char symbol : line) {
+        if (symbol == '"') {
+            in_quotes = !in_quotes;
+            in_argument = true;
+        }
+        else if (!in_quotes && std::isspace(static_cast<unsigned char>(symbol))) {
+            if (in_argument) {
+                arguments.push_back(argument);
+            }
+            argument.clear();
+            in_argument = false;
+        }
+        else {
+            argument += symbol;
+            in_argument = true;
+        }
     }
-    if (mode == "workdrive") {
-        return WorkMode::workdrive;
+    if (in_argument) {
+        arguments.push_back(argument);
     }
-    if (mode == "result") {
-        return WorkMode::result;
+    return arguments;
+}
+
+int run_command(int argc, const char* argv[], EngineCache& engines);
+
+// batch mode: runs one command per line of the manifest ("-" reads the lines from stdin as they arrive), each line holding
+// the arguments of a single invocation: INPUT OUTPUT [mode] [mode arguments...] [--options]. Blank lines and lines starting
+// with # are ignored. Options of the batch command line are defaults for every command, --jobs=N commands run at the same time.
+// Unless --threads is given, each command routes with the hardware threads divided by the job count.
+// All commands share the routing data of one EngineCache. One status line per finished command goes to the log file.
+int run_batch(const std::string& manifestFilename, const std::string& logFilename, const CommandLineOptions& options, const char* programName, EngineCache& engines) {
+    std::ifstream manifestFile;
+    if (manifestFilename != "-") {
+        manifestFile.open(manifestFilename);
+        if (!manifestFile.is_open()) {
+            throw std::runtime_error("error opening batch manifest " + manifestFilename);
+        }
     }
-    if (mode == "workdrivesymc") {
-        return WorkMode::workdrivesymc;
+    std::istream& manifest = manifestFilename == "-" ? std::cin : manifestFile;
+
+    std::ofstream logFile(logFilename);
+    if (!logFile.is_open()) {
+        throw std::runtime_error("error writing output file " + logFilename);
     }
-    if (mode == "resultsymc") {
-        return WorkMode::resultsymc;
+
+    const size_t job_count = std::max<size_t>(1, option_size(options, "jobs", default_thread_count()));
+    std::vector<std::string> defaultOptions;
+    for (const auto& option : options) {
+        if (option.first != "jobs") {
+            defaultOptions.push_back("--" + option.first + (option.second.empty() ? "" : "=" + option.second));
+        }
+    }
+    // the jobs share the cores: without --threads every command gets its share instead of all of them
+    if (options.count("threads") == 0) {
+        defaultOptions.push_back("--threads=" + std::to_string(std::max<size_t>(1, default_thread_count() / job_count)));
+    }
+
+    std::mutex mutex;
+    std::condition_variable command_ready;
+    std::deque<std::pair<size_t, std::string>> pending;
+    bool manifest_finished = false;
+    size_t failed_count = 0;
+
+    auto worker = [&]() {
+        while (true) {
+            std::pair<size_t, std::string> command;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                command_ready.wait(lock, [&]() { return !pending.empty() || manifest_finished; });
+                if (pending.empty()) {
+                    return;
+                }
+                command = std::move(pending.front());
+                pending.pop_front();
+            }
+
+            std::vector<std::string> arguments = split_command_line(command.second);
+            arguments.insert(arguments.begin(), defaultOptions.begin(), defaultOptions.end());
+            arguments.insert(arguments.begin(), programName);
+            std::vector<const char*> commandArgv;
+            for (const auto& argument : arguments) {
+                commandArgv.push_back(argument.c_str());
+            }
+
+            // the mode is the third positional argument once the options, defaults included, are taken out
+            std::vector<const char*> positionalArgv = commandArgv;
+            CommandLineOptions commandOptions;
+            const int positional_count = extract_options(static_cast<int>(positionalArgv.size()), positionalArgv.data(), commandOptions);
+
+            const auto start = std::chrono::steady_clock::now();
+            int exit_code;
+            if (positional_count > 3 && std::string(positionalArgv[3]) == "batch") {
+                std::cerr << "batch commands cannot be nested: " << command.second << '\n';
+                exit_code = EXIT_FAILURE;
+            }
+            else {
+                exit_code = run_command(static_cast<int>(commandArgv.size()), commandArgv.data(), engines);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (exit_code != 0) {
+                failed_count++;
+            }
+            logFile << command.first << ";" << (exit_code == 0 ? "OK" : "ERROR") << ";" << seconds << ";" << command.second << '\n';
+            logFile.flush();
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < job_count; i++) {
+        workers.emplace_back(worker);
+    }
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(manifest, line)) {
+        line_number++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        const size_t first_symbol = line.find_first_not_of(" \t");
+        if (first_symbol == std::string::npos || line[first_symbol] == '#') {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.emplace_back(line_number, line);
+        }
+        command_ready.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        manifest_finished = true;
+    }
+    command_ready.notify_all();
+    for (auto& thread : workers) {
+        thread.join();
     }
-    throw std::runtime_error("Unknown mode: " + mode + ". Supported modes: drive, workdrive, result, workdrivesymc, resultsymc.");
+
+    return failed_count == 0 ? 0 : EXIT_FAILURE;
 }
 
-int main(int argc, const char* argv[])
+int run_command(int argc, const char* argv[], EngineCache& engines)
 {
     try {
+        CommandLineOptions options;
+        argc = extract_options(argc, argv, options);
 
-        if (argc < 3)
+        const std::vector<std::string> unknown = unknown_options(options);
+        if (argc < 3 || !unknown.empty())
         {
+            for (const auto& name : unknown) {
+                std::cerr << "Unknown option: --" << name << "\n";
+            }
             std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT [drive | workdrive] [dampening-factor=1.0] [path-to-osrm-file=map_data\\germany-latest.osrm] " << "\n";
             std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT result INPUT-RESULT-FILE [dampening-factor=1.0] [path-to-osrm-file=map_data\\germany-latest.osrm] " << "\n";
             std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT workdrivesymc [worktime-limit-in-minutes=2400] [dampening-factor=1.0] [path-to-osrm-file=map_data\\germany-latest.osrm] " << "\n";
             std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT resultsymc OP-SOLVER-SOLUTION-FILE DISTANCE-MATRIX-INPUT-FILE [OUTPUT-JS-DEFINITIONS-FILENAME]" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT benchparse [repetitions=5]" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "SCRATCH-PREFIX REPORT bench [sizes=100,1000,10000,50000] [--bench-max-full=10000]    (phase timings of every mode on generated jobs, synthetic routing unless --backend=osrm, and of the SIMD cell kernels against the per cell loop)" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT REPORT benchalgo [path-to-osrm-file=map_data\\germany-latest.osrm] [--setups=ch,mld,ch-shm,mld-shm] [--repetitions=3]    (engine load and full table time of each algorithm and data source, default ch,mld)" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "MANIFEST-FILE|- LOG-FILE batch [--jobs=N]    (one \"INPUT OUTPUT mode ...\" command per line, the .osrm data is loaded once, each command defaults to hardware threads / N routing threads)" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT solve [worktime-limit-in-minutes=2400] [dampening-factor=1.0] [path-to-osrm-file=map_data\\germany-latest.osrm] [--starts=16] [--iterations=200]    (solves the workdrivesymc instance in process and writes the resultsymc report)" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT evaltours TOURS-FILE-OR-DIRECTORY DISTANCE-MATRIX-INPUT-FILE    (summary of many tours: a directory of .sol files or one line of job ids per tour, any workdrivesymc, binary or sparse matrix)" << "\n";
+            std::cerr << "Usage(order of arguments is important): " << argv[0] << " " << "INPUT OUTPUT sparse [dampening-factor=1.0] [path-to-osrm-file=map_data\\germany-latest.osrm] [--neighbours=20]    (edge list of every job to its nearest jobs and the depots 0 and 1)" << "\n";
+            std::cerr << "Options(anywhere on the command line): --tile-size=N split the table query into NxN tiles (0 = single query), --threads=N number of tile queries running in parallel" << "\n";
+            std::cerr << "Options: --stats write wall time, CPU time, the cumulative peak memory and its growth of every phase and counts (bytes_written over all written files) to OUTPUT.stats.json" << "\n";
+            std::cerr << "Options: --backend=synthetic route with great circle distances at --synthetic-speed=KMH (default 50) instead of the .osrm data, --synthetic-asymmetry=PERCENT makes legs heading east that much slower" << "\n";
+            std::cerr << "Options: --algorithm=ch|mld routing algorithm the .osrm data was prepared for (default mld), --shared-memory [--dataset-name=NAME] use the data osrm-datastore loaded instead of reading the files" << "\n";
+            std::cerr << "Options: --hints-cache=FILE keep the OSRM snapping hints of every job in FILE and reuse them for jobs whose coordinate is unchanged, dropped when the .osrm data changes" << "\n";
+            std::cerr << "Options(drive, workdrive, workdrivesymc, solve): jobs at the same coordinate are routed once, --dedup-tolerance=METERS also merges coordinates that close to each other, --no-dedup routes every job on its own" << "\n";
+            std::cerr << "Options: --binary-matrix write OUTPUT.matrix.bin (and one next to every --outputs file) for drive, workdrive, workdrivesymc and solve, --matrix=FILE read result mode durations from such a file instead of OSRM" << "\n";
+            std::cerr << "Options(workdrivesymc): --sparse-matrix=FILE build the matrix from a sparse edge list instead of OSRM (with its dampening factor, a positional one has to match it), pairs not in it get --missing-penalty=MINUTES (default COST_LIMIT + 1)" << "\n";
+            std::cerr << "Options(workdrivesymc): --triangle route only the tiles on or below the diagonal (--tile-size, default 1000), --symmetrise=min|max|mean route both directions once and write min, max or mean of each pair" << "\n";
+            std::cerr << "Options(resultsymc): --geojson=FILE write the jobs and the road geometry of every tour leg as GeoJSON, routed with --osrm-file=PATH (default map_data\\germany-latest.osrm)" << "\n";
+            std::cerr << "Options(drive, workdrive, workdrivesymc): --outputs=MODE:DAMPENING:FILE,... also write these drive, workdrive or workdrivesymc outputs from the same routed matrix, workdrivesymc:DAMPENING:COST_LIMIT:FILE sets the COST_LIMIT of a workdrivesymc output (needed unless the command is workdrivesymc)" << "\n";
+            std::cerr << "Options(drive, workdrive, workdrivesymc): --band-rows=R route and write R rows at a time with a checkpoint in OUTPUT.checkpoint after each band, the same command resumes an interrupted run" << "\n";
+            std::cerr << "Options(drive, workdrive, workdrivesymc): --previous-input=FILE --previous-output=FILE reuse the matrix of an earlier run with the same mode, dampening factor, dedup tolerance and symmetrisation (checked against the FILE.run it wrote), only added or changed jobs are routed" << "\n";
             std::cerr << "Example: " << argv[0] << " " << "input.txt output.result.txt result input.result.txt 1.0 map_data\\germany-latest.osrm " << "\n";
             std::cerr << "Example: " << argv[0] << " " << "input.txt output.txt resultsymc solver.o-148535.sol workdrivesymc.out.txt ..\\custom-markers-reduced\\features.js " << "\n";
             return EXIT_FAILURE;
@@ -69,6 +3728,12 @@ int main(int argc, const char* argv[])
 
         WorkMode work_mode = argc < 4 ? WorkMode::drive : parse_work_mode(argv[3]);
 
+        // solve builds the workdrivesymc matrix (with all its options) in memory and solves it instead of writing it
+        const bool solve_mode = work_mode == WorkMode::solve;
+        if (solve_mode) {
+            work_mode = WorkMode::workdrivesymc;
+        }
+
         int arg_offset = work_mode == WorkMode::result || work_mode == WorkMode::resultsymc || work_mode == WorkMode::workdrivesymc ? 1 : 0;
 
         std::string worktime_limit_in_minutes = "2400";
@@ -76,67 +3741,137 @@ int main(int argc, const char* argv[])
             worktime_limit_in_minutes = argv[4];
         }
 
-        std::ifstream inputFile(inputFilename);
-        if (!inputFile.is_open()) {
-            throw std::runtime_error("error opening input file " + inputFilename);
+        if (work_mode == WorkMode::batch) {
+            return run_batch(inputFilename, outputFilename, options, argv[0], engines);
         }
 
-        using namespace osrm;
-        TableParameters params;
-        //std::vector<double> workDuration;
-        std::vector<int> jobRowToId;
-        std::unordered_map<int, double> workDurationMap;
-        std::unordered_map<int, double> score1Map;
-
+        RunStats stats(options.count("stats") != 0, outputFilename, argc < 4 ? "drive" : argv[3]);
 
+        if (work_mode == WorkMode::benchparse) {
+            std::ofstream reportFile(outputFilename);
+            if (!reportFile.is_open()) {
+                throw std::runtime_error("error writing output file " + outputFilename);
+            }
+            std::ostringstream report;
+            benchmark_parsers(inputFilename, report, argc < 5 ? 5 : std::stoul(argv[4]));
+            reportFile << report.str();
+            std::cout << report.str();
+            return 0;
+        }
 
-        std::ofstream outputFile(outputFilename);
-        if (!outputFile.is_open()) {
-            throw std::runtime_error("error writing output file " + outputFilename);
+        if (work_mode == WorkMode::bench) {
+            std::ofstream reportFile(outputFilename);
+            if (!reportFile.is_open()) {
+                throw std::runtime_error("error writing output file " + outputFilename);
+            }
+            std::vector<size_t> sizes;
+            std::istringstream sizesStream(argc < 5 ? "100,1000,10000,50000" : argv[4]);
+            for (std::string size; std::getline(sizesStream, size, ',');) {
+                sizes.push_back(std::stoul(size));
+            }
+            // the synthetic backend unless --backend=osrm asks for the .osrm data of --osrm-file
+            CommandLineOptions backendOptions = options;
+            backendOptions.emplace("backend", "synthetic");
+            const auto osrmFile = options.count("osrm-file") != 0 ? options.at("osrm-file") : std::string("map_data/germany-latest.osrm");
+            std::ostringstream report;
+            benchmark_modes(engines.get(osrmFile, backendOptions), sizes, option_size(options, "bench-max-full", 10000), inputFilename,
+                static_cast<unsigned>(option_size(options, "threads", default_thread_count())), report);
+            benchmark_cell_kernels(sizes, option_size(options, "bench-max-full", 10000), report);
+            reportFile << report.str();
+            std::cout << report.str();
+            return 0;
         }
 
-        std::string line;
-        while (std::getline(inputFile, line)) {
+        if (work_mode == WorkMode::benchalgo) {
+            std::ofstream reportFile(outputFilename);
+            if (!reportFile.is_open()) {
+                throw std::runtime_error("error writing output file " + outputFilename);
+            }
+            JobColumns jobs;
             {
-                if (work_mode != WorkMode::result && work_mode != WorkMode::workdrivesymc && work_mode != WorkMode::resultsymc) {
-                    outputFile << line << "\n";
-                }
-
-                std::istringstream lineCheckStream(line);
-                char firstSymbol;
-                lineCheckStream >> firstSymbol;
-                if (!std::isdigit(firstSymbol)) {
-                    std::cerr << "skipping line: " << line << "\n";
-                    continue;
-                }
+                const MappedFile inputFile(inputFilename);
+                parse_jobs(inputFile.data(), inputFile.data() + inputFile.size(), jobs, [](std::string_view) {}, [](std::string_view) {});
             }
+            std::vector<EngineSettings> setups;
+            std::istringstream setupsStream(options.count("setups") != 0 ? options.at("setups") : std::string("ch,mld"));
+            for (std::string setup; std::getline(setupsStream, setup, ',');) {
+                setups.push_back(parse_engine_settings(setup, options.count("dataset-name") != 0 ? options.at("dataset-name") : std::string()));
+            }
+            std::ostringstream report;
+            benchmark_algorithms(argc < 5 ? "map_data/germany-latest.osrm" : argv[4], setups, jobs.coordinates(), option_size(options, "tile-size", 0),
+                static_cast<unsigned>(option_size(options, "threads", default_thread_count())), option_size(options, "repetitions", 3), report);
+            reportFile << report.str();
+            std::cout << report.str();
+            return 0;
+        }
 
-            std::istringstream lineStream(line);
-            char separator1;
-            char separator2;
-            char separator3;
-            char separator4;
-            int uniqueJobID;
-            double latitude;
-            double longitude;
-            double score1;
-            double score2;
+        stats.begin("parse");
+        const MappedFile inputFile(inputFilename);
 
-            lineStream >> uniqueJobID >> separator1 >> latitude >> separator2 >> longitude;
-            lineStream >> separator3 >> score1 >> separator4 >> score2;
+        using namespace osrm;
+        TableParameters params;
+        JobColumns jobs;
+        const std::vector<int>& jobRowToId = jobs.ids;
 
-            if (separator1 != ',' || separator2 != ',' || separator3 != ',' || separator4 != ',') {
-                throw std::runtime_error("invalid input line: " + line);
-            }
 
-            params.coordinates.push_back({ util::FloatLongitude{longitude}, util::FloatLatitude{latitude} });
-            //workDuration.push_back(score2);
 
-            jobRowToId.push_back(uniqueJobID);
-            workDurationMap[uniqueJobID] = score2;
-            score1Map[uniqueJobID] = score1;
+        // --band-rows: the checkpoint of an interrupted run with the same input and arguments is resumed, the output
+        // files are cut back to the last finished band and appended to
+        const size_t band_rows = option_size(options, "band-rows", 0);
+        BandCheckpoint checkpoint;
+        bool resume = false;
+        if (band_rows != 0) {
+            if (solve_mode || (work_mode != WorkMode::drive && work_mode != WorkMode::workdrive && work_mode != WorkMode::workdrivesymc)
+                || options.count("previous-input") != 0 || options.count("previous-output") != 0 || options.count("triangle") != 0
+                || options.count("symmetrise") != 0 || options.count("sparse-matrix") != 0) {
+                throw std::runtime_error("--band-rows is only supported for drive, workdrive and workdrivesymc without --previous-input, --triangle, --symmetrise or --sparse-matrix");
+            }
+            checkpoint.fingerprint = band_run_fingerprint(inputFile.data(), inputFile.size(), argc, argv, options);
+            checkpoint.band_rows = band_rows;
+            BandCheckpoint previous;
+            if (previous.read(checkpoint_filename(outputFilename)) && previous.fingerprint == checkpoint.fingerprint && previous.band_rows == band_rows) {
+                std::error_code output_error;
+                std::error_code binary_error;
+                const auto output_bytes = std::filesystem::file_size(outputFilename, output_error);
+                const auto binary_bytes = previous.binary_bytes == 0 ? 0 : std::filesystem::file_size(binary_matrix_filename(outputFilename), binary_error);
+                resume = !output_error && !binary_error && output_bytes >= previous.output_bytes && binary_bytes >= previous.binary_bytes;
+            }
+            if (resume) {
+                checkpoint = previous;
+                std::filesystem::resize_file(outputFilename, checkpoint.output_bytes);
+            }
+        }
+
+        std::ofstream outputFile(outputFilename, resume ? std::ios::in | std::ios::out | std::ios::ate : std::ios::out);
+        if (!outputFile.is_open()) {
+            throw std::runtime_error("error writing output file " + outputFilename);
         }
 
+        // a resumed output already starts with the input lines
+        const bool echo_input = (work_mode == WorkMode::drive || work_mode == WorkMode::workdrive) && !resume;
+        // the drive and workdrive variants of --outputs echo the input lines as well, they point into the mapped input
+        std::vector<OutputVariant> outputVariants = options.count("outputs") != 0 ? parse_output_variants(options.at("outputs")) : std::vector<OutputVariant>();
+        std::vector<std::string_view> inputLines;
+        parse_jobs(inputFile.data(), inputFile.data() + inputFile.size(), jobs,
+            [&](std::string_view line) {
+                if (!outputVariants.empty()) {
+                    inputLines.push_back(line);
+                }
+                if (echo_input) {
+                    outputFile.write(line.data(), line.size());
+                    outputFile << "\n";
+                }
+            },
+            [&stats](std::string_view line) {
+                std::cerr << "skipping line: " << line << "\n";
+                stats.add("skipped_lines", 1);
+            });
+        params.coordinates = jobs.coordinates();
+        stats.set("jobs", static_cast<double>(jobs.size()));
+        stats.end();
+
+        std::string line;
+
         if (work_mode == WorkMode::resultsymc) {
             if (argc < 6) {
                 std::cerr << "Error, an nsufficient number of arguments were supplied for the resultsymc mode" << '\n';
@@ -145,122 +3880,73 @@ int main(int argc, const char* argv[])
                 return EXIT_FAILURE;
             }
 
+            stats.begin("matrix_input");
             const std::string matrixInputFilename = argv[5];
-            std::ifstream matrixInputFile(matrixInputFilename);
-            if (!matrixInputFile.is_open()) {
-                throw std::runtime_error("error opening distance matrix input file " + matrixInputFilename);
+            MappedFile binaryMatrixFile;
+            BinaryMatrix binaryMatrix;
+            SparseMatrix sparseMatrix;
+            LegCosts legCosts(jobs, matrixInputFilename);
+            if (is_binary_matrix_file(matrixInputFilename)) {
+                binaryMatrixFile = MappedFile(matrixInputFilename);
+                binaryMatrix = open_binary_matrix(binaryMatrixFile, jobRowToId, matrixInputFilename);
+                legCosts.use_binary(binaryMatrix);
             }
-            std::vector< std::vector<int> > dampedDrivingTimeFromToMinutes;
-            do {
-                std::getline(matrixInputFile, line);
-                std::cout << "SKIPPED distance matrix input line: " << line << std::endl;
-            } while (line != "EDGE_WEIGHT_SECTION");
-
-
-            for (size_t row = 0; row < jobRowToId.size(); row++) {
-                std::string matrixRowLine;
-                std::getline(matrixInputFile, matrixRowLine);
-
-                std::istringstream lineStream(matrixRowLine);
-                std::vector<int> matrixRow;
-                std::copy(std::istream_iterator<int>(lineStream), std::istream_iterator<int>(), std::back_inserter(matrixRow));
-
-                for (size_t column = 0; column < matrixRow.size(); column++) {
-                    const double workFromDuration = workDurationMap.at(jobRowToId.at(row));
-                    const double workToDuration = workDurationMap.at(jobRowToId.at(column));
-                    matrixRow[column] -= workFromDuration/2.0;
-                    matrixRow[column] -= workToDuration/2.0;
-                }
-
-                dampedDrivingTimeFromToMinutes.push_back(matrixRow);
+            else if (is_sparse_matrix_file(matrixInputFilename)) {
+                sparseMatrix = read_sparse_matrix(matrixInputFilename, jobRowToId);
+                legCosts.use_sparse(sparseMatrix);
+            }
+            else {
+                legCosts.use_text_cells(read_text_matrix_cells(matrixInputFilename, jobRowToId.size(), &std::cout));
             }
 
+            // the same minutes for every matrix format, as resultsymc derives them from the workdrivesymc text output
+            auto dampedDrivingMinutes = [&](size_t from_station_row_index, size_t to_station_row_index) -> double {
+                return legCosts.symmetric_minutes(from_station_row_index, to_station_row_index);
+            };
+
+            stats.begin("report");
             const std::string resultInputFilename = argv[4];
             std::ifstream resultInputFile(resultInputFilename);
             if (!resultInputFile.is_open()) {
                 throw std::runtime_error("error opening result input file " + resultInputFilename);
             }
 
-            std::string line;
-            do {
-                std::getline(resultInputFile, line);
-                std::cout << "SKIPPED result input line: " << line << std::endl;
-            } while (line != "NODE_SEQUENCE_SECTION");
-            //output results file
-
-
-            std::vector<int> selectedJobsRowIndex; 
+            // the one based rows of NODE_SEQUENCE_SECTION, then row 1 appended as the end job
+            const std::vector<size_t> selectedJobsRowIndex = read_solution_rows(resultInputFile, jobRowToId.size());
 
-            std::string stopListLine;
-            int i = 0;
             double totalScore1 = 0;
             double totalWorkDuration = 0;
-            while (true) {
-                std::getline(resultInputFile, line);
-                if (line == "-1") {
-                    break;
-                }
-                std::istringstream lineStream(line);
-                int row_index_one_based;
-                lineStream >> row_index_one_based;
-                int row_index = row_index_one_based - 1;
-                int station_id = jobRowToId.at(row_index);
-                selectedJobsRowIndex.push_back(row_index);
-                totalScore1 += score1Map.at(station_id);
-                totalWorkDuration += workDurationMap.at(station_id);
-                outputFile << station_id;
+            for (size_t i = 0; i + 1 < selectedJobsRowIndex.size(); i++) {
+                const size_t row_index = selectedJobsRowIndex[i];
+                totalScore1 += jobs.score1.at(row_index);
+                totalWorkDuration += jobs.score2.at(row_index);
+                outputFile << jobRowToId.at(row_index);
                 outputFile << " ";
-                i++;
             }
 
-
             //TODO CHECK: final_station_id=1  is consistent with java solver output, but really there should be 0
-            selectedJobsRowIndex.push_back(1);
             outputFile << "1 "; 
 
 
             outputFile << '\n';
-            outputFile << totalScore1 << '\n';
-            outputFile << totalWorkDuration << '\n';
-
-            double dampedDrivingTimeSumMinutes = 0;
-            for (size_t i = 0; i < selectedJobsRowIndex.size() - 1; i++) {
-                int from_station_row_index = selectedJobsRowIndex[i];
-                int to_station_row_index = selectedJobsRowIndex[i+1];
-
-                if (from_station_row_index < to_station_row_index) { // hack because dampedDrivingTimeFromToMinutes contains triangular matrix form
-                    std::swap(from_station_row_index, to_station_row_index);
-                }
-
-                dampedDrivingTimeSumMinutes += dampedDrivingTimeFromToMinutes.at(from_station_row_index).at(to_station_row_index);
-            }
-
-            outputFile << std::lround(dampedDrivingTimeSumMinutes) << '\n';
-
-            const double totalTimeHours = (totalWorkDuration + dampedDrivingTimeSumMinutes)/60.0;
-            outputFile << std::fixed << std::setprecision(1) << totalTimeHours << std::setprecision(0) << '\n';
-
-            for (size_t i = 0; i < selectedJobsRowIndex.size(); i++) {
-                int drivingTimeFromPreviousJob = 0;
-                const int job_id = jobRowToId.at(selectedJobsRowIndex[i]);
-                if (i != 0) {
-                    int previous_job_row_index = selectedJobsRowIndex[i - 1];
-                    int job_row_index = selectedJobsRowIndex[i];
-                    if (previous_job_row_index < job_row_index) {
-                        std::swap(previous_job_row_index, job_row_index);
-                    }
+            TourTotals totals;
+            totals.score1Sum = totalScore1;
+            totals.workDurationSum = totalWorkDuration;
+            write_tour_report(outputFile, jobs, selectedJobsRowIndex, totals, dampedDrivingMinutes);
+            const double dampedDrivingTimeSumMinutes = totals.dampedDrivingMinutes;
+            const double totalTimeHours = totals.totalHours;
 
-                    drivingTimeFromPreviousJob = std::lround(dampedDrivingTimeFromToMinutes.at(previous_job_row_index).at(job_row_index));
-                }
-                outputFile << job_id << ";" << drivingTimeFromPreviousJob << ";" << workDurationMap.at(job_id) << ";" << "\n";
+            std::vector<bool> isSelected(jobRowToId.size(), false);
+            for (const size_t row : selectedJobsRowIndex) {
+                isSelected[row] = true;
             }
 
 
-
             if (argc >= 7) {
                 const std::string js_definitions_filename = argv[6];
 
                 std::ofstream js_file(js_definitions_filename);
+                stats.written(js_definitions_filename);
                 if (!js_file.is_open()) {
                     throw std::runtime_error("error writing is definitions file " + js_definitions_filename);
                 }
@@ -286,8 +3972,8 @@ int main(int argc, const char* argv[])
                         continue;
                     }
 
-                    const double priority = score1Map.at(job_id);
-                    const int duration = workDurationMap.at(job_id);
+                    const double priority = jobs.score1.at(i);
+                    const int duration = jobs.score2.at(i);
                     if (duration < 1) {
                         continue;
                     }
@@ -304,12 +3990,10 @@ int main(int argc, const char* argv[])
                     const double latitude = params.coordinates.at(i).lat.__value/1000000.0;
                     const double longitude = params.coordinates.at(i).lon.__value/1000000.0;
                     const int job_id = jobRowToId.at(i);
-                    const double priority = score1Map.at(job_id);
-                    const int duration = workDurationMap.at(job_id);
-
-                    const bool is_selected = std::find(selectedJobsRowIndex.begin(), selectedJobsRowIndex.end(), i) != selectedJobsRowIndex.end();
+                    const double priority = jobs.score1.at(i);
+                    const int duration = jobs.score2.at(i);
 
-                    std::string type =  is_selected ? "active" : "inactive";
+                    std::string type =  isSelected[i] ? "active" : "inactive";
                     int size1;
                     int size2;
                     if (job_id == 0 || job_id == 1) {
@@ -369,65 +4053,182 @@ int main(int argc, const char* argv[])
                 js_file << std::endl << "];" << std::endl;
 
             }
+
+            if (options.count("geojson") != 0) {
+                // the report is complete before the legs are routed
+                outputFile.flush();
+                stats.begin("geojson");
+
+                const std::string geojsonFilename = options.at("geojson");
+                std::ofstream geojsonFile(geojsonFilename);
+                stats.written(geojsonFilename);
+                if (!geojsonFile.is_open()) {
+                    throw std::runtime_error("error writing GeoJSON file " + geojsonFilename);
+                }
+                const auto osrmFile = options.count("osrm-file") != 0 ? options.at("osrm-file") : std::string("map_data/germany-latest.osrm");
+                const unsigned thread_count = static_cast<unsigned>(option_size(options, "threads", default_thread_count()));
+                write_tour_geojson(geojsonFile, engines.get(osrmFile, options), jobs, params.coordinates, selectedJobsRowIndex, isSelected, thread_count);
+            }
             return 0;
         }
 
+        if (work_mode == WorkMode::evaltours) {
+            if (argc < 6) {
+                throw std::runtime_error("evaltours needs TOURS-FILE-OR-DIRECTORY and DISTANCE-MATRIX-INPUT-FILE");
+            }
+            const std::string toursPath = argv[4];
+            const std::string matrixInputFilename = argv[5];
+            const unsigned thread_count = static_cast<unsigned>(option_size(options, "threads", default_thread_count()));
 
-        std::string pathToOsrmFile = argc < (6 + arg_offset) ? "map_data/germany-latest.osrm" : argv[5 + arg_offset];
-
-        double dampeningFactor = argc < (5 + arg_offset) ? 1.0 : std::stod(argv[4 + arg_offset]);
+            stats.begin("read_tours");
+            std::vector<CandidateTour> tours = read_candidate_tours(toursPath, jobRowToId);
+            stats.set("tours", static_cast<double>(tours.size()));
+            stats.begin("evaluate");
+            MappedFile binaryMatrixFile;
+            BinaryMatrix binaryMatrix;
+            SparseMatrix sparseMatrix;
+            LegCosts legCosts(jobs, matrixInputFilename);
+            if (is_binary_matrix_file(matrixInputFilename)) {
+                binaryMatrixFile = MappedFile(matrixInputFilename);
+                binaryMatrix = open_binary_matrix(binaryMatrixFile, jobRowToId, matrixInputFilename);
+                legCosts.use_binary(binaryMatrix);
+            }
+            else if (is_sparse_matrix_file(matrixInputFilename)) {
+                sparseMatrix = read_sparse_matrix(matrixInputFilename, jobRowToId);
+                legCosts.use_sparse(sparseMatrix);
+            }
+            else {
+                legCosts.use_text_cells(read_text_matrix_cells(matrixInputFilename, jobRowToId.size(), nullptr));
+            }
+            const std::vector<TourTotals> totals = evaluate_tours(tours, jobs, thread_count, [&](size_t from, size_t to) -> double {
+                return legCosts.symmetric_minutes(from, to);
+            });
 
+            stats.begin("write");
+            write_tour_summary(outputFile, tours, totals);
+            std::cout << "evaltours: " << tours.size() << " tours evaluated" << std::endl;
+            return 0;
+        }
 
-        // Configure based on a .osrm base path, and no datasets in shared mem from osrm-datastore
-        EngineConfig config;
 
-        config.storage_config = { pathToOsrmFile };
-        config.use_shared_memory = false;
+        std::string pathToOsrmFile = argc < (6 + arg_offset) ? "map_data/germany-latest.osrm" : argv[5 + arg_offset];
 
-        // We support two routing speed up techniques:
-        // - Contraction Hierarchies (CH): requires extract+contract pre-processing
-        // - Multi-Level Dijkstra (MLD): requires extract+partition+customize pre-processing
-        //
-        // config.algorithm = EngineConfig::Algorithm::CH;
-        config.algorithm = EngineConfig::Algorithm::MLD;
+        const bool dampening_given = argc >= (5 + arg_offset);
+        double dampeningFactor = dampening_given ? std::stod(argv[4 + arg_offset]) : 1.0;
 
-        // Routing machine with several services (such as Route, Table, Nearest, Trip, Match)
-        const OSRM osrm{ config };
 
+        // result mode with --matrix and workdrivesymc with --sparse-matrix read the durations from a file and do not need the routing data
+        const bool sparse_input = work_mode == WorkMode::workdrivesymc && options.count("sparse-matrix") != 0;
+        const RoutingBackend* backend = nullptr;
+        if ((work_mode != WorkMode::result || options.count("matrix") == 0) && !sparse_input) {
+            stats.begin("engine_load");
+            backend = &engines.get(pathToOsrmFile, options);
+            stats.end();
+        }
 
 
-        // Response is in JSON format
-        engine::api::ResultT result = json::Object();
 
-        auto& json_result = result.get<json::Object>();
+        const size_t tile_size = option_size(options, "tile-size", 0);
+        const unsigned thread_count = static_cast<unsigned>(option_size(options, "threads", default_thread_count()));
 
-        //todo move out of scope uninitialized values
-        const auto status = osrm.Table(params, result);
+        const bool delta_mode = options.count("previous-input") != 0 || options.count("previous-output") != 0;
+        if (delta_mode && (work_mode == WorkMode::result || work_mode == WorkMode::sparse || options.count("previous-input") == 0 || options.count("previous-output") == 0)) {
+            throw std::runtime_error("--previous-input and --previous-output have to be given together, for drive, workdrive or workdrivesymc mode");
+        }
 
-        if (status == Status::Error)
-        {
-            std::string code = json_result.values["code"].get<json::String>().value;
-            std::string message = json_result.values["message"].get<json::String>().value;
+        const bool triangle_mode = options.count("triangle") != 0 || options.count("symmetrise") != 0;
+        const Symmetrisation symmetrisation = options.count("symmetrise") != 0 ? parse_symmetrisation(options.at("symmetrise")) : Symmetrisation::none;
+        if (triangle_mode && (work_mode != WorkMode::workdrivesymc || delta_mode)) {
+            throw std::runtime_error("--triangle and --symmetrise are only supported for workdrivesymc without --previous-input");
+        }
+        const double dedup_tolerance = options.count("dedup-tolerance") != 0 ? std::stod(options.at("dedup-tolerance")) : 0.0;
+        if (options.count("no-dedup") != 0 && dedup_tolerance != 0.0) {
+            throw std::runtime_error("--no-dedup cannot be combined with --dedup-tolerance");
+        }
+        if (delta_mode && dedup_tolerance != 0.0) {
+            throw std::runtime_error("--dedup-tolerance cannot be combined with --previous-input, the changed jobs are routed at their own coordinates");
+        }
 
-            throw std::runtime_error("OSRM error: " + code + ". " + message);
+        // the settings of the output cells, written to OUTPUT.run once a drive, workdrive or workdrivesymc output is complete.
+        // Outputs from a --sparse-matrix get none, their cells are not routed by this run and cannot be reused.
+        const bool writes_run_settings = !solve_mode && !sparse_input
+            && (work_mode == WorkMode::drive || work_mode == WorkMode::workdrive || work_mode == WorkMode::workdrivesymc);
+        RunSettings runSettings;
+        runSettings.mode = argc < 4 ? "drive" : argv[3];
+        runSettings.dampeningFactor = dampeningFactor;
+        runSettings.dedupTolerance = dedup_tolerance;
+        runSettings.symmetrisation = options.count("symmetrise") != 0 ? options.at("symmetrise") : "none";
+        if (writes_run_settings) {
+            std::remove(run_settings_filename(outputFilename).c_str());
+        }
+        auto write_run_settings = [&](std::ofstream& file, const std::string& filename, const RunSettings& settings) {
+            if (!file.flush()) {
+                throw std::runtime_error("error writing output file " + filename);
+            }
+            settings.write(run_settings_filename(filename));
+            stats.written(filename);
+            stats.written(run_settings_filename(filename));
+        };
+        if (sparse_input && (delta_mode || triangle_mode)) {
+            throw std::runtime_error("--sparse-matrix cannot be combined with --previous-input, --triangle or --symmetrise");
+        }
+        if (!outputVariants.empty()) {
+            if (solve_mode || (work_mode != WorkMode::drive && work_mode != WorkMode::workdrive && work_mode != WorkMode::workdrivesymc)
+                || delta_mode || sparse_input || band_rows != 0) {
+                throw std::runtime_error("--outputs is only supported for drive, workdrive and workdrivesymc without --previous-input, --sparse-matrix or --band-rows");
+            }
+            for (auto& variant : outputVariants) {
+                if (triangle_mode && variant.mode != WorkMode::workdrivesymc) {
+                    throw std::runtime_error("--triangle and --symmetrise only route the lower triangle, --outputs can only add workdrivesymc variants");
+                }
+                if (variant.mode == WorkMode::workdrivesymc && variant.costLimit.empty()) {
+                    if (work_mode != WorkMode::workdrivesymc) {
+                        throw std::runtime_error("the workdrivesymc variant " + variant.filename + " needs its COST_LIMIT unless the command is workdrivesymc: "
+                            + "--outputs=workdrivesymc:DAMPENING:COST_LIMIT:FILE");
+                    }
+                    variant.costLimit = worktime_limit_in_minutes;
+                }
+            }
         }
 
-        const auto& durations_matrix = json_result.values["durations"].get<json::Array>();
-        if (work_mode == WorkMode::result) {
-            std::string resultInputFilename = argv[4];
+        std::vector<size_t> allRows(params.coordinates.size());
+        std::iota(allRows.begin(), allRows.end(), 0);
 
-            std::unordered_map<int, std::unordered_map<int, double> > drivingTimeFromTo;
-            for (size_t indexFrom = 0; indexFrom < durations_matrix.values.size(); indexFrom++) {
-                auto& durations_array = durations_matrix.values.at(indexFrom);
-                auto& durations = durations_array.get<json::Array>();
-                const int jobFromId = jobRowToId.at(indexFrom);
-                for (size_t indexTo = 0; indexTo < durations.values.size(); indexTo++) {
-                    const int jobToId = jobRowToId.at(indexTo);
-                    auto duration_value = durations.values[indexTo];
-                    auto duration = duration_value.get<json::Number>();
-                    drivingTimeFromTo[jobFromId][jobToId] = duration.value;
-                }
+        // --hints-cache: the Table queries start from the snapping hints of earlier runs, the hints of the coordinates they
+        // snapped are stored after routing. hintRows are the job rows of the coordinates the queries are indexed by.
+        HintsCache* hintsCache = backend != nullptr && options.count("hints-cache") != 0 ? &engines.hints(options.at("hints-cache"), *backend) : nullptr;
+        std::unique_ptr<SnappingHints> snappingHints;
+        std::vector<size_t> hintRows;
+        auto load_hints = [&](const std::vector<size_t>& rows) -> SnappingHints* {
+            if (hintsCache == nullptr) {
+                return nullptr;
+            }
+            hintRows = rows;
+            snappingHints.reset(new SnappingHints(rows.size()));
+            const size_t found = hintsCache->lookup(jobRowToId, params.coordinates, rows, *snappingHints);
+            std::cout << "hints cache: " << found << " of " << rows.size() << " jobs already snapped" << std::endl;
+            stats.set("cached_hints", static_cast<double>(found));
+            return snappingHints.get();
+        };
+        auto store_hints = [&]() {
+            if (snappingHints) {
+                hintsCache->update(jobRowToId, params.coordinates, hintRows, *snappingHints);
             }
+        };
+
+        if (work_mode == WorkMode::sparse) {
+            const size_t neighbours = option_size(options, "neighbours", 20);
+            stats.begin("routing");
+            SparseMatrix sparse = query_sparse_durations(*backend, jobs, params.coordinates, neighbours, thread_count, load_hints(allRows));
+            store_hints();
+            sparse.dampeningFactor = dampeningFactor;
+            stats.set("cells", static_cast<double>(sparse.columns.size()));
+            stats.begin("write");
+            write_sparse_matrix(outputFile, outputFilename, inputFilename, neighbours, jobRowToId, sparse);
+            std::cout << "sparse: " << sparse.columns.size() << " routed pairs for " << jobRowToId.size() << " jobs" << std::endl;
+        }
+        else if (work_mode == WorkMode::result) {
+            std::string resultInputFilename = argv[4];
 
             std::ifstream resultInputFile(resultInputFilename);
             if (!resultInputFile.is_open()) {
@@ -449,95 +4250,383 @@ int main(int argc, const char* argv[])
             std::vector<int> jobIds;
             std::copy(std::istream_iterator<int>(lineStream), std::istream_iterator<int>(), std::back_inserter(jobIds));
 
-            double workDurationSum = 0;
-            for (size_t i = 0; i < jobIds.size(); i++) {
-                workDurationSum += workDurationMap.at(jobIds[i]);
+            // Only the legs of the tour are needed: the stops are mapped to matrix rows once
+            // and OSRM is asked for the small stops x stops table instead of all jobs x all jobs.
+            std::unordered_map<int, size_t> rowOfJobId;
+            for (size_t row = 0; row < jobRowToId.size(); row++) {
+                rowOfJobId[jobRowToId[row]] = row;
+            }
+            std::vector<size_t> tourRows;
+            for (const int jobId : jobIds) {
+                const auto row = rowOfJobId.find(jobId);
+                if (row == rowOfJobId.end()) {
+                    throw std::runtime_error("job " + std::to_string(jobId) + " of " + resultInputFilename + " is not in " + inputFilename);
+                }
+                tourRows.push_back(row->second);
+            }
+
+            stats.begin("routing");
+            MappedFile binaryMatrixFile;
+            BinaryMatrix binaryMatrix;
+            DurationMatrix stopDurations;
+            std::vector<size_t> stopIndexOfRow(jobRowToId.size(), 0);
+            LegCosts legCosts(jobs, options.count("matrix") != 0 ? options.at("matrix") : std::string("the routed tour stops"));
+            if (options.count("matrix") != 0) {
+                binaryMatrixFile = MappedFile(options.at("matrix"));
+                binaryMatrix = open_binary_matrix(binaryMatrixFile, jobRowToId, options.at("matrix"));
+                legCosts.use_binary(binaryMatrix);
+            }
+            else {
+                std::vector<size_t> stopRows = tourRows;
+                std::sort(stopRows.begin(), stopRows.end());
+                stopRows.erase(std::unique(stopRows.begin(), stopRows.end()), stopRows.end());
+                for (size_t stop = 0; stop < stopRows.size(); stop++) {
+                    stopIndexOfRow[stopRows[stop]] = stop;
+                }
+                stopDurations = query_table_durations(*backend, params.coordinates, stopRows, stopRows, tile_size, thread_count, load_hints(allRows));
+                store_hints();
+                legCosts.use_stops(stopDurations, stopIndexOfRow, dampeningFactor);
             }
-            outputFile << workDurationSum << '\n';
+            stats.begin("write");
+            write_result_report(outputFile, jobs, jobIds, tourRows, legCosts, dampeningFactor);
+        }
+        else if (band_rows != 0) {
+            // --band-rows: the matrix is routed and written band_rows rows at a time, so memory holds the durations of one band
+            // instead of the whole matrix. After every band the output files are flushed and the checkpoint is updated.
+            const size_t size = jobRowToId.size();
+            const std::vector<double>& workDurations = jobs.score2;
+            const bool lower = work_mode == WorkMode::workdrivesymc;
 
-            double baseDrivingTimeSum = 0;
-            for (size_t i = 0; i < jobIds.size() - 1; i++) {
-                int fromId = jobIds[i];
-                int toId = jobIds[i + 1];
-                baseDrivingTimeSum += drivingTimeFromTo.at(fromId).at(toId);
+            stats.begin("bands");
+            const CoordinateDedup dedup = options.count("no-dedup") != 0 ? identity_dedup(size) : dedup_coordinates(params.coordinates, dedup_tolerance);
+            if (dedup.uniqueRows.size() != size) {
+                std::cout << "dedup: " << size << " jobs at " << dedup.uniqueRows.size() << " distinct coordinates" << std::endl;
+                stats.set("distinct_coordinates", static_cast<double>(dedup.uniqueRows.size()));
+            }
 
+            const bool write_binary = options.count("binary-matrix") != 0;
+            const std::string matrixFilename = binary_matrix_filename(outputFilename);
+            std::ofstream matrixFile;
+            if (!write_binary) {
+                std::remove(matrixFilename.c_str());
+            }
+            else {
+                if (resume) {
+                    std::filesystem::resize_file(matrixFilename, checkpoint.binary_bytes);
+                    matrixFile.open(matrixFilename, std::ios::binary | std::ios::in | std::ios::out | std::ios::ate);
+                }
+                else {
+                    matrixFile.open(matrixFilename, std::ios::binary);
+                }
+                if (!matrixFile.is_open()) {
+                    throw std::runtime_error("error writing binary matrix file " + matrixFilename);
+                }
+                stats.written(matrixFilename);
+                if (!resume) {
+                    write_binary_matrix_header(matrixFile, lower ? MatrixLayout::lower_triangle : MatrixLayout::full, dampeningFactor, jobRowToId);
+                }
+            }
+            if (lower && !resume) {
+                write_op_header(outputFile, outputFilename, inputFilename, size, worktime_limit_in_minutes);
             }
-            const double drivingTimeSumMinutes = baseDrivingTimeSum * dampeningFactor / 60.0;
-            outputFile << std::lround(drivingTimeSumMinutes) << '\n';
+            if (resume) {
+                std::cout << "resuming " << outputFilename << " at row " << checkpoint.next_row << " of " << size << std::endl;
+                stats.set("resumed_at_row", static_cast<double>(checkpoint.next_row));
+            }
+
+            SnappingHints* hints = load_hints(allRows);
+            const size_t no_index = static_cast<size_t>(-1);
+            std::vector<size_t> bandIndexOfUnique(dedup.uniqueRows.size(), no_index);
+            std::vector<float> binaryRow;
+            for (size_t first_row = checkpoint.next_row; first_row < size; first_row += band_rows) {
+                const size_t end_row = std::min(first_row + band_rows, size);
 
-            const double totalTimeHours = (workDurationSum + drivingTimeSumMinutes)/60.0;
-            outputFile << std::fixed << std::setprecision(1) << totalTimeHours << std::setprecision(0) << '\n';
+                // one source per distinct coordinate of the band, workdrivesymc only needs the columns up to the last row of
+                // the band, whose distinct coordinates are a prefix of uniqueRows
+                std::vector<size_t> sources;
+                for (size_t row = first_row; row < end_row; row++) {
+                    const size_t unique = dedup.uniqueOf[row];
+                    if (bandIndexOfUnique[unique] == no_index) {
+                        bandIndexOfUnique[unique] = sources.size();
+                        sources.push_back(dedup.uniqueRows[unique]);
+                    }
+                }
+                const size_t column_count = lower
+                    ? std::lower_bound(dedup.uniqueRows.begin(), dedup.uniqueRows.end(), end_row) - dedup.uniqueRows.begin()
+                    : dedup.uniqueRows.size();
+                const std::vector<size_t> destinations(dedup.uniqueRows.begin(), dedup.uniqueRows.begin() + column_count);
+                const DurationMatrix band = query_table_durations(*backend, params.coordinates, sources, destinations, tile_size, thread_count, hints);
+                store_hints();
+
+                auto duration = [&](size_t indexFrom, size_t indexTo) {
+                    return band.row(bandIndexOfUnique[dedup.uniqueOf[indexFrom]])[dedup.uniqueOf[indexTo]];
+                };
+                const MatrixRowCells row_cells = [&](size_t indexFrom, std::vector<long>& cells) {
+                    const size_t count = lower ? indexFrom + 1 : size;
+                    const float* durations = band.row(bandIndexOfUnique[dedup.uniqueOf[indexFrom]]);
+                    std::vector<float> gathered;
+                    if (dedup.uniqueRows.size() != size) {
+                        gathered.resize(count);
+                        for (size_t indexTo = 0; indexTo < count; indexTo++) {
+                            gathered[indexTo] = duration(indexFrom, indexTo);
+                        }
+                        durations = gathered.data();
+                    }
+                    output_cells(best_cell_kernel(), work_mode, durations, count, dampeningFactor, workDurations[indexFrom], workDurations.data(), cells.data());
+                };
+                write_matrix_rows(outputFile, size, first_row, end_row, lower ? MatrixTextFormat::lower_diag_row : MatrixTextFormat::drive, row_cells, thread_count);
+                if (write_binary) {
+                    for (size_t indexFrom = first_row; indexFrom < end_row; indexFrom++) {
+                        binaryRow.resize(lower ? indexFrom + 1 : size);
+                        for (size_t indexTo = 0; indexTo < binaryRow.size(); indexTo++) {
+                            binaryRow[indexTo] = duration(indexFrom, indexTo);
+                        }
+                        matrixFile.write(reinterpret_cast<const char*>(binaryRow.data()), binaryRow.size() * sizeof(float));
+                    }
+                }
+                for (size_t row = first_row; row < end_row; row++) {
+                    bandIndexOfUnique[dedup.uniqueOf[row]] = no_index;
+                }
 
-            for (size_t i = 0; i < jobIds.size(); i++) {
-                int drivingTimeFromPreviousJob = 0;
-                if (i != 0) {
-                    drivingTimeFromPreviousJob = std::lround(drivingTimeFromTo.at(jobIds[i - 1]).at(jobIds[i])* dampeningFactor / 60.0);
+                outputFile.flush();
+                matrixFile.flush();
+                if (!outputFile || (write_binary && !matrixFile)) {
+                    throw std::runtime_error("error writing output file " + outputFilename);
                 }
-                outputFile << jobIds[i] << ";" << drivingTimeFromPreviousJob << ";" << workDurationMap.at(jobIds[i]) << ";" << "\n";
+                checkpoint.next_row = end_row;
+                checkpoint.output_bytes = static_cast<std::uint64_t>(outputFile.tellp());
+                checkpoint.binary_bytes = write_binary ? static_cast<std::uint64_t>(matrixFile.tellp()) : 0;
+                checkpoint.write(checkpoint_filename(outputFilename));
+                stats.add("bands", 1);
+            }
+
+            if (lower) {
+                write_op_footer(outputFile, jobs);
+            }
+            outputFile.flush();
+            if (!outputFile) {
+                throw std::runtime_error("error writing output file " + outputFilename);
             }
+            std::remove(checkpoint_filename(outputFilename).c_str());
+            write_run_settings(outputFile, outputFilename, runSettings);
+            stats.set("cells", static_cast<double>(lower ? size * (size + 1) / 2 : size * size));
         }
         else {
-            if (work_mode == WorkMode::workdrivesymc) {
-                outputFile << "NAME: " << outputFilename << std::endl;
-                outputFile << "COMMENT : based on input from "  << inputFilename << std::endl;
-                outputFile << "TYPE : OP" << std::endl;
-                outputFile << "DIMENSION : " << durations_matrix.values.size() <<  std::endl;
-                outputFile << "COST_LIMIT : " << worktime_limit_in_minutes << std::endl;
-                outputFile << "EDGE_WEIGHT_TYPE : EXPLICIT" << std::endl;
-                outputFile << "EDGE_WEIGHT_FORMAT : LOWER_DIAG_ROW" << std::endl;
-                outputFile << "NODE_COORD_TYPE : NO_COORDS" << std::endl;
-                outputFile << "DISPLAY_DATA_TYPE : NO_DISPLAY" << std::endl;
-                outputFile << "EDGE_WEIGHT_SECTION" << std::endl;
-                for (size_t indexFrom = 0; indexFrom < durations_matrix.values.size(); indexFrom++) {
-                    auto& durations_array = durations_matrix.values.at(indexFrom);
-                    auto& durations = durations_array.get<json::Array>();
-                    bool iterates_first_value = true;
-//                    outputFile << "D,  ";
+            const size_t size = jobRowToId.size();
+            const std::vector<double>& workDurations = jobs.score2;
 
+            PreviousRun previous_run;
+            DeltaMatrix delta_matrix;
+            DurationMatrix durations_matrix;
+            CoordinateDedup dedup;
+            SparseMatrix sparse_matrix;
+            MatrixRowCells row_cells;
+
+            // job rows to the rows and columns of the deduplicated durations_matrix, empty if they are the same
+            // (also after expand_lower_triangle, which leaves one row per job)
+            const std::vector<size_t> noMapping;
+            auto matrixRowOf = [&]() -> const std::vector<size_t>& {
+                return dedup.uniqueRows.size() == size || durations_matrix.rows == size ? noMapping : dedup.uniqueOf;
+            };
+            // the output cells of one mode and dampening factor from durations_matrix, for the command and every --outputs variant.
+            // Deduplicated rows are gathered into job order first, so both cases run the vector kernel over a contiguous row.
+            const CellKernel kernel = best_cell_kernel();
+            auto routed_row_cells = [&](WorkMode mode, double dampening) -> MatrixRowCells {
+                if (matrixRowOf().empty()) {
+                    return [&, mode, dampening](size_t indexFrom, std::vector<long>& cells) {
+                        const size_t count = mode == WorkMode::workdrivesymc ? indexFrom + 1 : size;
+                        output_cells(kernel, mode, durations_matrix.row(indexFrom), count, dampening, workDurations[indexFrom], workDurations.data(), cells.data());
+                    };
+                }
+                return [&, mode, dampening](size_t indexFrom, std::vector<long>& cells) {
+                    const size_t count = mode == WorkMode::workdrivesymc ? indexFrom + 1 : size;
+                    const size_t matrixRow = dedup.uniqueOf[indexFrom];
+                    std::vector<float> durations(count);
+                    for (size_t indexTo = 0; indexTo < count; indexTo++) {
+                        durations[indexTo] = durations_matrix.value(matrixRow, dedup.uniqueOf[indexTo]);
+                    }
+                    output_cells(kernel, mode, durations.data(), count, dampening, workDurations[indexFrom], workDurations.data(), cells.data());
+                };
+            };
+
+            stats.begin(sparse_input ? "matrix_input" : "routing");
+            if (sparse_input) {
+                sparse_matrix = read_sparse_matrix(options.at("sparse-matrix"), jobRowToId);
+                // the cells use the dampening factor the sparse matrix was written with, a different positional one would be ignored
+                if (dampening_given && dampeningFactor != sparse_matrix.dampeningFactor) {
+                    std::ostringstream message;
+                    message << "dampening factor " << dampeningFactor << " differs from the dampening factor " << sparse_matrix.dampeningFactor << " of the sparse matrix "
+                        << options.at("sparse-matrix") << ", give the same factor or leave it out";
+                    throw std::runtime_error(message.str());
+                }
+                // pairs that were not routed get a cell above COST_LIMIT, so the solver never uses them
+                const long missing_penalty = static_cast<long>(option_size(options, "missing-penalty", std::stoul(worktime_limit_in_minutes) + 1));
+                std::remove(binary_matrix_filename(outputFilename).c_str());
+                row_cells = [&, missing_penalty](size_t indexFrom, std::vector<long>& cells) {
                     for (size_t indexTo = 0; indexTo <= indexFrom; indexTo++) {
-                        auto duration_value = durations.values[indexTo];
-                        auto duration = duration_value.get<json::Number>();
-                        double durationInMinutes = duration.value * dampeningFactor / 60.0;
-                        durationInMinutes += workDurationMap.at(jobRowToId.at(indexTo)) / 2.0;
-                        durationInMinutes += workDurationMap.at(jobRowToId.at(indexFrom)) / 2.0;
-
-                        if (!iterates_first_value) {
-                            outputFile << " ";
+                        double seconds;
+                        cells[indexTo] = sparse_matrix.seconds(indexFrom, indexTo, seconds)
+                            ? output_cell(work_mode, seconds, sparse_matrix.dampeningFactor, workDurations[indexFrom], workDurations[indexTo])
+                            : missing_penalty;
+                    }
+                };
+            }
+            else if (delta_mode) {
+                // cells of another mode, dampening factor or dedup tolerance are on another scale than the ones routed now
+                RunSettings previousSettings;
+                if (!previousSettings.read(run_settings_filename(options.at("previous-output")))) {
+                    throw std::runtime_error("no run settings " + run_settings_filename(options.at("previous-output")) + " next to the previous output, only complete "
+                        "drive, workdrive and workdrivesymc outputs of this version can be reused");
+                }
+                if (!(previousSettings == runSettings)) {
+                    throw std::runtime_error("previous output " + options.at("previous-output") + " was computed with " + previousSettings.describe()
+                        + ", this run uses " + runSettings.describe());
+                }
+                previous_run = read_previous_run(options.at("previous-input"), options.at("previous-output"), work_mode);
+                delta_matrix = build_delta_matrix(previous_run, work_mode, params.coordinates, jobRowToId, workDurations, *backend, tile_size, thread_count, load_hints(allRows));
+                store_hints();
+                // the reused cells carry no routed seconds, a binary matrix from an earlier run would not match this output
+                std::remove(binary_matrix_filename(outputFilename).c_str());
+                row_cells = [&](size_t indexFrom, std::vector<long>& cells) {
+                    const size_t count = work_mode == WorkMode::workdrivesymc ? indexFrom + 1 : size;
+                    for (size_t indexTo = 0; indexTo < count; indexTo++) {
+                        if (!delta_matrix.previous_cell(indexFrom, indexTo, cells[indexTo])) {
+                            cells[indexTo] = output_cell(work_mode, delta_matrix.seconds(indexFrom, indexTo), dampeningFactor, workDurations[indexFrom], workDurations[indexTo]);
                         }
-                        outputFile << std::lround(durationInMinutes);
-                        iterates_first_value = false;
                     }
-                    outputFile << '\n';
+                };
+            }
+            else {
+                // only distinct coordinates are routed, the job rows are mapped to their rows when the output is written
+                dedup = options.count("no-dedup") != 0 ? identity_dedup(size) : dedup_coordinates(params.coordinates, dedup_tolerance);
+                if (dedup.uniqueRows.size() != size) {
+                    std::cout << "dedup: " << size << " jobs at " << dedup.uniqueRows.size() << " distinct coordinates" << std::endl;
+                    stats.set("distinct_coordinates", static_cast<double>(dedup.uniqueRows.size()));
+                }
+                if (triangle_mode) {
+                    std::vector<Coordinate> uniqueCoordinates;
+                    for (const size_t row : dedup.uniqueRows) {
+                        uniqueCoordinates.push_back(params.coordinates[row]);
+                    }
+                    SnappingHints* hints = load_hints(dedup.uniqueRows);
+                    durations_matrix = query_lower_triangle_durations(*backend, uniqueCoordinates, tile_size == 0 ? default_triangle_tile_size : tile_size, thread_count, symmetrisation,
+                        hints);
+                    // a folded pair is the same in both directions, without --symmetrise the rows of repeated coordinates need their own direction
+                    if (symmetrisation == Symmetrisation::none && dedup.uniqueRows.size() != size) {
+                        durations_matrix = expand_lower_triangle(durations_matrix, dedup, *backend, uniqueCoordinates, tile_size, thread_count, hints);
+                    }
+                }
+                else {
+                    durations_matrix = query_table_durations(*backend, params.coordinates, dedup.uniqueRows, dedup.uniqueRows, tile_size, thread_count, load_hints(allRows));
+                }
+                store_hints();
+                // the binary companion doubles the output IO, it is only written with --binary-matrix (solve included).
+                // A companion of an earlier run would not match this output and is removed.
+                if (options.count("binary-matrix") != 0) {
+                    stats.begin("write_binary");
+                    write_binary_matrix(binary_matrix_filename(outputFilename), work_mode == WorkMode::workdrivesymc ? MatrixLayout::lower_triangle : MatrixLayout::full,
+                        dampeningFactor, jobRowToId, durations_matrix, matrixRowOf());
+                    stats.written(binary_matrix_filename(outputFilename));
                 }
-                outputFile << "NODE_SCORE_SECTION" << std::endl;
-                for (size_t i = 0; i < durations_matrix.values.size(); i++) {
-                    outputFile << i + 1 << " " << score1Map.at(jobRowToId.at(i)) << std::endl;
+                else {
+                    std::remove(binary_matrix_filename(outputFilename).c_str());
                 }
+                row_cells = routed_row_cells(work_mode, dampeningFactor);
+            }
+
+            if (stats.enabled()) {
+                // the cells are computed on the writer threads, their time is summed up separately
+                row_cells = [&stats, compute_cells = row_cells](size_t indexFrom, std::vector<long>& cells) {
+                    const auto start = std::chrono::steady_clock::now();
+                    compute_cells(indexFrom, cells);
+                    stats.add("postprocess_thread_seconds", std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                };
+            }
+            stats.set("cells", static_cast<double>(work_mode == WorkMode::workdrivesymc ? size * (size + 1) / 2 : size * size));
+
+            if (solve_mode) {
+                stats.begin("postprocess");
+                SymmetricCosts costs;
+                costs.cells.reserve(size * (size + 1) / 2);
+                std::vector<long> cells(size);
+                for (size_t indexFrom = 0; indexFrom < size; indexFrom++) {
+                    row_cells(indexFrom, cells);
+                    costs.cells.insert(costs.cells.end(), cells.begin(), cells.begin() + indexFrom + 1);
+                }
+
+                // like the external solver: a path from the first to the second job of INPUT
+                if (size < 2) {
+                    throw std::runtime_error("solve needs the start and end jobs in the first two lines of " + inputFilename);
+                }
+                stats.begin("solve");
+                const long cost_limit = std::stol(worktime_limit_in_minutes);
+                const OrienteeringSolver solver(costs, jobs.score1, 0, 1, cost_limit);
+                const OrienteeringTour tour = solver.solve(option_size(options, "starts", default_solver_starts), option_size(options, "iterations", 200), thread_count);
+                std::cout << "solve: score " << tour.score << ", cost " << tour.cost << " of " << cost_limit << ", " << tour.rows.size() << " stops" << std::endl;
+                stats.begin("write");
 
-                outputFile << "EOF" << std::endl;                
+                for (const size_t row : tour.rows) {
+                    outputFile << jobRowToId[row] << " ";
+                }
+                outputFile << '\n';
+                TourTotals totals;
+                for (const size_t row : tour.rows) {
+                    totals.score1Sum += jobs.score1[row];
+                    totals.workDurationSum += jobs.score2[row];
+                }
+                // the driving minutes of the LOWER_DIAG_ROW cells, computed as resultsymc reads them from the workdrivesymc output
+                write_tour_report(outputFile, jobs, tour.rows, totals, [&](size_t from, size_t to) -> double {
+                    return symmetric_leg_minutes(costs(from, to), workDurations[std::max(from, to)], workDurations[std::min(from, to)]);
+                });
+            }
+            else if (work_mode == WorkMode::workdrivesymc) {
+                stats.begin("write");
+                write_op_header(outputFile, outputFilename, inputFilename, size, worktime_limit_in_minutes);
+                write_matrix_text(outputFile, size, MatrixTextFormat::lower_diag_row, row_cells, thread_count);
+                write_op_footer(outputFile, jobs);
             }
             else {
-                for (size_t indexFrom = 0; indexFrom < durations_matrix.values.size(); indexFrom++) {
-                    auto& durations_array = durations_matrix.values.at(indexFrom);
-                    auto& durations = durations_array.get<json::Array>();
-                    bool iterates_first_value = true;
-                    outputFile << "D,  ";
-
-                    for (size_t indexTo = 0; indexTo < durations.values.size(); indexTo++) {
-                        auto duration_value = durations.values[indexTo];
-                        auto duration = duration_value.get<json::Number>();
-                        double durationInMinutes = duration.value * dampeningFactor / 60.0;
-                        if (work_mode == WorkMode::workdrive) {
-                            durationInMinutes += workDurationMap.at(jobRowToId.at(indexTo));
-                        }
-                        if (!iterates_first_value) {
-                            outputFile << ",\t";
-                        }
-                        outputFile << std::lround(durationInMinutes);
-                        iterates_first_value = false;
+                stats.begin("write");
+                write_matrix_text(outputFile, size, MatrixTextFormat::drive, row_cells, thread_count);
+            }
+            if (writes_run_settings) {
+                write_run_settings(outputFile, outputFilename, runSettings);
+            }
+
+            // --outputs: the variants only differ in post-processing, all of them are written from the matrix routed above
+            if (!outputVariants.empty()) {
+                stats.begin("write_outputs");
+            }
+            for (const auto& variant : outputVariants) {
+                std::ofstream variantFile(variant.filename);
+                if (!variantFile.is_open()) {
+                    throw std::runtime_error("error writing output file " + variant.filename);
+                }
+                if (variant.mode == WorkMode::workdrivesymc) {
+                    write_op_header(variantFile, variant.filename, inputFilename, size, variant.costLimit);
+                    write_matrix_text(variantFile, size, MatrixTextFormat::lower_diag_row, routed_row_cells(variant.mode, variant.dampeningFactor), thread_count);
+                    write_op_footer(variantFile, jobs);
+                }
+                else {
+                    for (const auto line : inputLines) {
+                        variantFile.write(line.data(), line.size());
+                        variantFile << "\n";
                     }
-                    outputFile << ',' << '\n';
+                    write_matrix_text(variantFile, size, MatrixTextFormat::drive, routed_row_cells(variant.mode, variant.dampeningFactor), thread_count);
+                }
+                RunSettings variantSettings = runSettings;
+                variantSettings.mode = variant.modeName;
+                variantSettings.dampeningFactor = variant.dampeningFactor;
+                write_run_settings(variantFile, variant.filename, variantSettings);
+                if (options.count("binary-matrix") != 0) {
+                    write_binary_matrix(binary_matrix_filename(variant.filename), variant.mode == WorkMode::workdrivesymc ? MatrixLayout::lower_triangle : MatrixLayout::full,
+                        variant.dampeningFactor, jobRowToId, durations_matrix, matrixRowOf());
+                    stats.written(binary_matrix_filename(variant.filename));
+                }
+                else {
+                    std::remove(binary_matrix_filename(variant.filename).c_str());
                 }
+                std::cout << "output: " << variant.filename << " (" << variant.modeName << ", dampening factor " << variant.dampeningFactor << ")" << std::endl;
             }
         }
         return 0;
@@ -547,3 +4636,9 @@ int main(int argc, const char* argv[])
         return 1;
     }
 }
+
+int main(int argc, const char* argv[])
+{
+    EngineCache engines;
+    return run_command(argc, argv, engines);
+}
@@ -0,0 +1,80 @@
+#!/bin/bash
+# Checks that resultsymc and evaltours report the same tour costs whether they read the workdrivesymc text matrix or the
+# .matrix.bin written next to it, and that --triangle keeps the routed direction of every pair, also for jobs that repeat
+# an earlier coordinate. Routes with the synthetic backend, so no .osrm dataset is needed.
+#
+# Usage: tests/matrix_formats_test.sh PATH-TO-TABLE-EXECUTABLE
+set -eu
+
+TABLE=${1:?usage: $0 PATH-TO-TABLE-EXECUTABLE}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# jobs around Berlin with odd work durations, so that halving them truncates. The last 40 jobs repeat the coordinate
+# of an earlier one, they share its row of the routed matrix.
+awk 'BEGIN {
+    srand(4);
+    print "# id,lat,lon,score1,score2";
+    print "0,52.520008,13.404954,0,0";
+    lat[0] = 52.520008; lon[0] = 13.404954;
+    for (id = 1; id < 160; id++) {
+        if (id < 120) {
+            lat[id] = 52.3 + rand() * 0.5; lon[id] = 13.1 + rand() * 0.6;
+        }
+        else {
+            repeated = int(rand() * 120); lat[id] = lat[repeated]; lon[id] = lon[repeated];
+        }
+        printf "%d,%.6f,%.6f,%d,%d\n", id, lat[id], lon[id], int(rand() * 10), 1 + 2 * int(rand() * 40);
+    }
+}' > "$WORK/input.txt"
+
+{
+    echo "NAME: test"
+    echo "NODE_SEQUENCE_SECTION"
+    for node in 1 17 44 3 98 61 120 25 9 73 1; do echo "$node"; done
+    echo "-1"
+    echo "EOF"
+} > "$WORK/tour.sol"
+echo "0 16 43 2 97 60 119 24 8 72 0" > "$WORK/tours.txt"
+echo "0 5 11 83 101 39 0" >> "$WORK/tours.txt"
+
+"$TABLE" "$WORK/input.txt" "$WORK/matrix.txt" workdrivesymc 2400 1.3 none --backend=synthetic --binary-matrix > /dev/null
+test -f "$WORK/matrix.txt.matrix.bin"
+
+failed=0
+for mode in resultsymc evaltours; do
+    for matrix in matrix.txt matrix.txt.matrix.bin; do
+        if [ "$mode" = resultsymc ]; then
+            "$TABLE" "$WORK/input.txt" "$WORK/$mode.$matrix.out" resultsymc "$WORK/tour.sol" "$WORK/$matrix" "$WORK/$mode.$matrix.js" > /dev/null
+        else
+            "$TABLE" "$WORK/input.txt" "$WORK/$mode.$matrix.out" evaltours "$WORK/tours.txt" "$WORK/$matrix" > /dev/null
+        fi
+    done
+    if ! cmp -s "$WORK/$mode.matrix.txt.out" "$WORK/$mode.matrix.txt.matrix.bin.out"; then
+        echo "FAILED: $mode reports differ between the text and the binary matrix"
+        diff "$WORK/$mode.matrix.txt.out" "$WORK/$mode.matrix.txt.matrix.bin.out" | head -10
+        failed=1
+    fi
+done
+if ! cmp -s "$WORK/resultsymc.matrix.txt.js" "$WORK/resultsymc.matrix.txt.matrix.bin.js"; then
+    echo "FAILED: resultsymc js exports differ between the text and the binary matrix"
+    failed=1
+fi
+
+# with asymmetric durations a cell read in the wrong direction changes the output
+for triangle in "--triangle" "--triangle --tile-size=16" "--no-dedup --triangle --tile-size=16"; do
+    "$TABLE" "$WORK/input.txt" "$WORK/plain.txt" workdrivesymc 2400 1.3 none --backend=synthetic --synthetic-asymmetry=20 --binary-matrix > /dev/null
+    "$TABLE" "$WORK/input.txt" "$WORK/triangle.txt" workdrivesymc 2400 1.3 none --backend=synthetic --synthetic-asymmetry=20 --binary-matrix $triangle > /dev/null
+    if ! diff -q <(tail -n +2 "$WORK/plain.txt") <(tail -n +2 "$WORK/triangle.txt") > /dev/null; then
+        echo "FAILED: workdrivesymc $triangle differs from plain workdrivesymc"
+        diff <(tail -n +2 "$WORK/plain.txt") <(tail -n +2 "$WORK/triangle.txt") | head -6
+        failed=1
+    fi
+    if ! cmp -s "$WORK/plain.txt.matrix.bin" "$WORK/triangle.txt.matrix.bin"; then
+        echo "FAILED: workdrivesymc $triangle binary matrix differs from plain workdrivesymc"
+        failed=1
+    fi
+done
+
+[ "$failed" = 0 ] && echo "OK: text and binary matrices give identical reports, --triangle keeps the routed directions"
+exit "$failed"